@@ -0,0 +1,274 @@
+#pragma once
+
+//flat_set
+//
+//open-addressing hash set with inline storage and linear probing.
+//each slot caches the hash of its value, so growth never rehashes and most
+//mismatched probes are rejected without calling T::operator==.
+//removal shifts the following cluster back rather than leaving tombstones.
+//
+//search: O(1) average; O(n) worst
+//insert: O(1) average; O(n) worst
+//remove: O(1) average; O(n) worst
+//
+//references returned by find() and insert() are invalidated by insert() and remove(),
+//but remain valid when the set itself is moved.
+//each() visits every value, in no particular order.
+//
+//requirements:
+//  auto T::hash() const -> unsigned;
+//  auto T::operator==(const T&) const -> bool;
+
+namespace nall {
+
+template<typename T>
+struct flat_set {
+  flat_set() = default;
+  flat_set(const flat_set& source) { operator=(source); }
+  flat_set(flat_set&& source) { operator=(std::move(source)); }
+  ~flat_set() { reset(); }
+
+  auto operator=(const flat_set& source) -> flat_set& {
+    if(&source == this) return *this;
+    reset();
+    if(source.pool) {
+      reserve(source.count);
+      for(unsigned n : range(source.length)) {
+        if(source.pool[n].hash) place(source.pool[n].hash, source.pool[n].value());
+      }
+    }
+    return *this;
+  }
+
+  auto operator=(flat_set&& source) -> flat_set& {
+    if(&source == this) return *this;
+    reset();
+    pool = source.pool;
+    length = source.length;
+    count = source.count;
+    source.pool = nullptr;
+    source.length = 0;
+    source.count = 0;
+    return *this;
+  }
+
+  explicit operator bool() const { return count; }
+  auto capacity() const -> unsigned { return length; }
+  auto size() const -> unsigned { return count; }
+
+  auto reset() -> void {
+    if(!pool) return;
+    for(unsigned n : range(length)) {
+      if(pool[n].hash) pool[n].value().~T();
+    }
+    memory::free(pool);
+    pool = nullptr;
+    length = 0;
+    count = 0;
+  }
+
+  //ensure size values can be held without growing
+  auto reserve(unsigned size) -> void {
+    unsigned capacity = bit::round(size + (size >> 1) + 1);
+    if(capacity < 8) capacity = 8;
+    if(capacity <= length) return;
+
+    auto source = pool;
+    auto sourceLength = length;
+    pool = memory::allocate<Slot>(capacity);
+    for(unsigned n : range(capacity)) pool[n].hash = 0;
+    length = capacity;
+    count = 0;
+
+    if(!source) return;
+    for(unsigned n : range(sourceLength)) {
+      if(!source[n].hash) continue;
+      place(source[n].hash, std::move(source[n].value()));
+      source[n].value().~T();
+    }
+    memory::free(source);
+  }
+
+  auto find(const T& value) -> maybe<T&> {
+    if(!count) return nothing;
+    unsigned hash = slotHash(value);
+    for(unsigned n = hash & (length - 1); pool[n].hash; n = (n + 1) & (length - 1)) {
+      if(pool[n].hash == hash && value == pool[n].value()) return pool[n].value();
+    }
+    return nothing;
+  }
+
+  //replaces an equal value if one is already present
+  auto insert(const T& value) -> maybe<T&> {
+    unsigned hash = slotHash(value);
+    if(count) {
+      for(unsigned n = hash & (length - 1); pool[n].hash; n = (n + 1) & (length - 1)) {
+        if(pool[n].hash == hash && value == pool[n].value()) return pool[n].value() = value;
+      }
+    }
+
+    //keep load at or below 2/3
+    reserve(count + 1);
+    return place(hash, value);
+  }
+
+  auto remove(const T& value) -> bool {
+    if(!count) return false;
+    unsigned hash = slotHash(value);
+    unsigned mask = length - 1;
+    unsigned n = hash & mask;
+    while(true) {
+      if(!pool[n].hash) return false;
+      if(pool[n].hash == hash && value == pool[n].value()) break;
+      n = (n + 1) & mask;
+    }
+
+    pool[n].value().~T();
+    pool[n].hash = 0;
+    count--;
+
+    //move any later value of the probe cluster whose home slot does not lie between the hole and itself
+    for(unsigned hole = n, next = (n + 1) & mask; pool[next].hash; next = (next + 1) & mask) {
+      unsigned home = pool[next].hash & mask;
+      if(((next - home) & mask) < ((next - hole) & mask)) continue;
+      new(pool[hole].storage) T(std::move(pool[next].value()));
+      pool[hole].hash = pool[next].hash;
+      pool[next].value().~T();
+      pool[next].hash = 0;
+      hole = next;
+    }
+    return true;
+  }
+
+  template<typename F> auto each(const F& callback) const -> void {
+    for(unsigned n : range(length)) {
+      if(pool[n].hash) callback(pool[n].value());
+    }
+  }
+
+private:
+  struct Slot {
+    unsigned hash;  //0 when empty
+    alignas(T) uint8_t storage[sizeof(T)];
+
+    auto value() -> T& { return *(T*)storage; }
+    auto value() const -> const T& { return *(const T*)storage; }
+  };
+
+  //0 is reserved to mark empty slots
+  static auto slotHash(const T& value) -> unsigned {
+    unsigned hash = value.hash();
+    return hash ? hash : 1;
+  }
+
+  template<typename U> auto place(unsigned hash, U&& value) -> T& {
+    unsigned n = hash & (length - 1);
+    while(pool[n].hash) n = (n + 1) & (length - 1);
+    new(pool[n].storage) T(std::forward<U>(value));
+    pool[n].hash = hash;
+    count++;
+    return pool[n].value();
+  }
+
+  Slot* pool = nullptr;
+  unsigned length = 0;  //number of slots; always a power of two once allocated
+  unsigned count = 0;   //number of values held
+};
+
+//inline_set
+//
+//holds up to Capacity values inside the object itself, searched linearly by cached hash;
+//further values spill into a flat_set. suited to many short-lived, mostly tiny sets.
+//
+//references returned by find() and insert() are invalidated by insert(), remove(),
+//and by moving the set.
+
+template<typename T, unsigned Capacity>
+struct inline_set {
+  inline_set() = default;
+  inline_set(const inline_set& source) { operator=(source); }
+  inline_set(inline_set&& source) { operator=(std::move(source)); }
+  ~inline_set() { reset(); }
+
+  auto operator=(const inline_set& source) -> inline_set& {
+    if(&source == this) return *this;
+    reset();
+    for(unsigned n : range(source.count)) {
+      new(storage[n]) T(source.item(n));
+      hashes[n] = source.hashes[n];
+    }
+    count = source.count;
+    overflow = source.overflow;
+    return *this;
+  }
+
+  auto operator=(inline_set&& source) -> inline_set& {
+    if(&source == this) return *this;
+    reset();
+    for(unsigned n : range(source.count)) {
+      new(storage[n]) T(std::move(source.item(n)));
+      hashes[n] = source.hashes[n];
+    }
+    count = source.count;
+    overflow = std::move(source.overflow);
+    source.reset();
+    return *this;
+  }
+
+  explicit operator bool() const { return size(); }
+  auto size() const -> unsigned { return count + overflow.size(); }
+
+  auto reset() -> void {
+    for(unsigned n : range(count)) item(n).~T();
+    count = 0;
+    overflow.reset();
+  }
+
+  auto find(const T& value) -> maybe<T&> {
+    unsigned hash = value.hash();
+    for(unsigned n : range(count)) {
+      if(hashes[n] == hash && value == item(n)) return item(n);
+    }
+    if(!overflow) return nothing;
+    return overflow.find(value);
+  }
+
+  //replaces an equal value if one is already present
+  auto insert(const T& value) -> maybe<T&> {
+    if(auto found = find(value)) return found() = value;
+    if(count == Capacity) return overflow.insert(value);
+    new(storage[count]) T(value);
+    hashes[count] = value.hash();
+    return item(count++);
+  }
+
+  auto remove(const T& value) -> bool {
+    unsigned hash = value.hash();
+    for(unsigned n : range(count)) {
+      if(hashes[n] != hash || !(value == item(n))) continue;
+      if(n != --count) {
+        item(n) = std::move(item(count));
+        hashes[n] = hashes[count];
+      }
+      item(count).~T();
+      return true;
+    }
+    return overflow.remove(value);
+  }
+
+  template<typename F> auto each(const F& callback) const -> void {
+    for(unsigned n : range(count)) callback(item(n));
+    overflow.each(callback);
+  }
+
+private:
+  auto item(unsigned n) -> T& { return *(T*)storage[n]; }
+  auto item(unsigned n) const -> const T& { return *(const T*)storage[n]; }
+
+  unsigned hashes[Capacity];
+  alignas(T) uint8_t storage[Capacity][sizeof(T)];
+  unsigned count = 0;
+  flat_set<T> overflow;
+};
+
+}
@@ -23,8 +23,8 @@ struct hashset {
   auto operator=(const hashset& source) -> hashset& {
     reset();
     if(source.pool) {
-      for(unsigned n : range(source.count)) {
-        insert(*source.pool[n]);
+      for(unsigned n : range(source.length)) {
+        if(source.pool[n]) insert(*source.pool[n]);
       }
     }
     return *this;
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <nall/hashset.hpp>
+
+namespace nall::Eval {
+
+//bump allocator for expression trees
+//nodes are never freed individually: reset() releases every node at once,
+//while keeping the allocated blocks for reuse by the next parse
+struct Arena {
+  Arena() = default;
+  Arena(const Arena&) = delete;
+  auto operator=(const Arena&) -> Arena& = delete;
+  ~Arena() { reset(); for(auto block : blocks) memory::free(block); }
+
+  auto create(Node::Type type = Node::Type::Null) -> Node* {
+    if(offset == BlockSize) block++, offset = 0;
+    if(block == blocks.size()) blocks.append(memory::allocate<Node>(BlockSize));
+    return new(blocks[block] + offset++) Node(type);
+  }
+
+  //literals are interned, so that repeated identifiers share one copy-on-write buffer
+  auto intern(const string& literal) -> string {
+    if(auto result = literals.find(literal)) return result();
+    return literals.insert(literal)();
+  }
+
+  auto reset() -> void {
+    for(unsigned n : range(blocks.size())) {
+      if(n > block) break;
+      for(unsigned index : range(n < block ? BlockSize : offset)) blocks[n][index].~Node();
+    }
+    block = 0;
+    offset = 0;
+    literals.reset();
+  }
+
+private:
+  static constexpr unsigned BlockSize = 256;
+  vector<Node*> blocks;
+  unsigned block = 0;
+  unsigned offset = 0;
+  hashset<string> literals;
+};
+
+}
@@ -27,11 +27,10 @@ struct Node {
 
   Type type;
   string literal;
-  vector<Node*> link;
+  vector<Node*> link;  //owned by the Arena that created this node
 
   Node() : type(Type::Null) {}
   Node(Type type) : type(type) {}
-  ~Node() { for(auto& node : link) delete node; }
 };
 
 }
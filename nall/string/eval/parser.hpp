@@ -29,53 +29,53 @@ inline auto whitespace(char n) -> bool {
 //  a<<<b a>>>b a<<<=b a>>>=b rotation operators were added
 //  a~b a~=b concatenation operators were added
 //  a??b coalesce operator was added
-inline auto parse(Node*& node, const char*& s, unsigned depth) -> void {
+inline auto parse(Node*& node, const char*& s, unsigned depth, Arena& arena) -> void {
   auto unaryPrefix = [&](Node::Type type, unsigned seek, unsigned depth) {
-    auto parent = new Node(type);
-    parse(parent->link(0) = new Node, s += seek, depth);
+    auto parent = arena.create(type);
+    parse(parent->link(0) = arena.create(), s += seek, depth, arena);
     node = parent;
   };
 
   auto unarySuffix = [&](Node::Type type, unsigned seek, unsigned depth) {
-    auto parent = new Node(type);
+    auto parent = arena.create(type);
     parent->link(0) = node;
-    parse(parent, s += seek, depth);
+    parse(parent, s += seek, depth, arena);
     node = parent;
   };
 
   auto binary = [&](Node::Type type, unsigned seek, unsigned depth) {
-    auto parent = new Node(type);
+    auto parent = arena.create(type);
     parent->link(0) = node;
-    parse(parent->link(1) = new Node, s += seek, depth);
+    parse(parent->link(1) = arena.create(), s += seek, depth, arena);
     node = parent;
   };
 
   auto ternary = [&](Node::Type type, unsigned seek, unsigned depth) {
-    auto parent = new Node(type);
+    auto parent = arena.create(type);
     parent->link(0) = node;
-    parse(parent->link(1) = new Node, s += seek, depth);
+    parse(parent->link(1) = arena.create(), s += seek, depth, arena);
     if(s[0] != ':') throw "mismatched ternary";
-    parse(parent->link(2) = new Node, s += seek, depth);
+    parse(parent->link(2) = arena.create(), s += seek, depth, arena);
     node = parent;
   };
 
   auto separator = [&](Node::Type type, unsigned seek, unsigned depth) {
     if(node->type != Node::Type::Separator) return binary(type, seek, depth);
     unsigned n = node->link.size();
-    parse(node->link(n) = new Node, s += seek, depth);
+    parse(node->link(n) = arena.create(), s += seek, depth, arena);
   };
 
   while(whitespace(s[0])) s++;
   if(!s[0]) return;
 
   if(s[0] == '(' && !node->link) {
-    parse(node, s += 1, 1);
+    parse(node, s += 1, 1, arena);
     if(*s++ != ')') throw "mismatched group";
   }
 
   if(isLiteral(s)) {
     node->type = Node::Type::Literal;
-    node->literal = literal(s);
+    node->literal = arena.intern(literal(s));
   }
 
   #define p() (!node->literal && !node->link)
@@ -185,10 +185,10 @@ inline auto parse(Node*& node, const char*& s, unsigned depth) -> void {
   #undef p
 }
 
-inline auto parse(const string& expression) -> Node* {
-  auto result = new Node;
+inline auto parse(const string& expression, Arena& arena) -> Node* {
+  auto result = arena.create();
   const char* p = expression;
-  parse(result, p, 0);
+  parse(result, p, 0, arena);
   return result;
 }
 
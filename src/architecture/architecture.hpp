@@ -27,6 +27,22 @@ struct Architecture {
     return self.directives;
   }
 
+  bool converging() const {
+    return self.converging;
+  }
+
+  unsigned guesses() const {
+    return self.guesses;
+  }
+
+  bool relax(bool outOfRange, bool guessed) {
+    return self.relax(outOfRange, guessed);
+  }
+
+  nall::string cacheDirectory() const {
+    return self.cacheDirectory;
+  }
+
   nall::string readArchitecture(const nall::string& s) {
     return self.readArchitecture(s);
   }
@@ -0,0 +1,147 @@
+//parsed tables are cached in memory for the lifetime of the process, and optionally on disk.
+//both caches are keyed by a SHA256 of the table text and the text of every file it includes.
+
+nall::hashset<Table::Cache>& Table::cache() {
+  static nall::hashset<Cache> cache;
+  return cache;
+}
+
+void Table::fingerprint(nall::Hash::SHA256& hash, const nall::string& text) {
+  hash.input(text);
+  for(auto line : text.split("\n")) {
+    if(auto position = line.find("//")) line.resize(position());
+    if(line[0] != '#' || !line.find("#include ")) continue;
+    line.trimLeft("#include ", 1L);
+    fingerprint(hash, readArchitecture(line.strip()));
+  }
+}
+
+nall::string Table::cacheLocation(const nall::string& key) {
+  auto directory = cacheDirectory();
+  if(!directory) return {};
+  if(!directory.endsWith("/")) directory.append("/");
+  return {directory, key, ".bac"};
+}
+
+//file layout: magic, version, opcodes, settings, then the key as a trailer.
+//the mnemonic index is rebuilt from the opcodes rather than stored.
+static const nall::string CacheMagic = "bass-arch";
+static const unsigned CacheVersion = 2;
+
+bool Table::loadCache(const nall::string& key) {
+  auto location = cacheLocation(key);
+  if(!location || !nall::file::exists(location)) return false;
+  auto fp = nall::file::open(location, nall::file::mode::read);
+  if(!fp) return false;
+
+  auto readString = [&]() -> nall::string {
+    unsigned length = fp.readl<unsigned>(4);
+    if(length > fp.size() - fp.offset()) return {};
+    return fp.reads(length);
+  };
+  auto readCount = [&]() -> unsigned {
+    unsigned count = fp.readl<unsigned>(4);
+    return count <= fp.size() - fp.offset() ? count : 0;
+  };
+
+  if(fp.reads(CacheMagic.size()) != CacheMagic) return false;
+  if(fp.readl<unsigned>(4) != CacheVersion) return false;
+
+  Definition loaded;
+  for(unsigned opcodes = readCount(); opcodes; opcodes--) {
+    Opcode opcode;
+    for(unsigned n = readCount(); n; n--) {
+      Prefix prefix;
+      prefix.text = readString();
+      prefix.size = fp.readl<unsigned>(4);
+      opcode.prefix.push_back(prefix);
+    }
+    for(unsigned n = readCount(); n; n--) {
+      opcode.number.push_back({fp.readl<unsigned>(4)});
+    }
+    for(unsigned n = readCount(); n; n--) {
+      Format format;
+      format.type = (Format::Type)fp.read();
+      format.match = (Format::Match)fp.read();
+      format.data = fp.readl<unsigned>(4);
+      format.bits = fp.readl<unsigned>(4);
+      format.argument = fp.readl<unsigned>(4);
+      format.displacement = fp.readl<int>(4);
+      opcode.format.push_back(format);
+    }
+    opcode.pattern = readString();
+    opcode.relaxation = readString();
+    loaded.table.push_back(opcode);
+  }
+  for(unsigned settings = readCount(); settings; settings--) {
+    Setting setting;
+    setting.type = (Setting::Type)fp.read();
+    setting.endian = (Bass::Endian)fp.read();
+    setting.token = readString();
+    setting.dataLength = fp.readl<unsigned>(4);
+    loaded.settings.push_back(setting);
+  }
+
+  //a truncated or corrupt file will not reproduce the trailer
+  if(readString() != key || !fp.end()) return false;
+
+  definition->table = std::move(loaded.table);
+  definition->settings = std::move(loaded.settings);
+  for(unsigned index : nall::range(definition->table.size())) indexOpcode(index);
+  return true;
+}
+
+void Table::saveCache(const nall::string& key) {
+  auto location = cacheLocation(key);
+  if(!location) return;
+
+  //write to a temporary file first, so that a concurrent reader never sees a partial cache
+  nall::string temporary = {location, ".tmp"};
+  {
+    auto fp = nall::file::open(temporary, nall::file::mode::write);
+    if(!fp) return;
+
+    auto writeString = [&](const nall::string& s) {
+      fp.writel(s.size(), 4);
+      fp.writes(s);
+    };
+
+    fp.writes(CacheMagic);
+    fp.writel(CacheVersion, 4);
+
+    fp.writel(definition->table.size(), 4);
+    for(auto& opcode : definition->table) {
+      fp.writel(opcode.prefix.size(), 4);
+      for(auto& prefix : opcode.prefix) {
+        writeString(prefix.text);
+        fp.writel(prefix.size, 4);
+      }
+      fp.writel(opcode.number.size(), 4);
+      for(auto& number : opcode.number) {
+        fp.writel(number.bits, 4);
+      }
+      fp.writel(opcode.format.size(), 4);
+      for(auto& format : opcode.format) {
+        fp.write((unsigned)format.type);
+        fp.write((unsigned)format.match);
+        fp.writel(format.data, 4);
+        fp.writel(format.bits, 4);
+        fp.writel(format.argument, 4);
+        fp.writel(format.displacement, 4);
+      }
+      writeString(opcode.pattern);
+      writeString(opcode.relaxation);
+    }
+
+    fp.writel(definition->settings.size(), 4);
+    for(auto& setting : definition->settings) {
+      fp.write((unsigned)setting.type);
+      fp.write((unsigned)setting.endian);
+      writeString(setting.token);
+      fp.writel(setting.dataLength, 4);
+    }
+
+    writeString(key);
+  }
+  if(!nall::file::move(temporary, location)) nall::inode::remove(temporary);
+}
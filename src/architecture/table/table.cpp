@@ -1,7 +1,24 @@
+#include "cache.cpp"
+
 Table::Table(Bass& self, const nall::string& table) : Architecture(self) {
   bitval = 0;
   bitpos = 0;
-  parseTable(table);
+
+  nall::Hash::SHA256 hash;
+  fingerprint(hash, table);
+  auto key = hash.digest();
+
+  if(auto cached = cache().find({key})) {
+    definition = cached->definition;
+  } else {
+    definition = new Definition;
+    if(!loadCache(key)) {
+      parseTable(table);
+      saveCache(key);
+    }
+    cache().insert({key, definition});
+  }
+  applySettings(0);
 }
 
 bool Table::assemble(const nall::string& statement) {
@@ -9,18 +26,41 @@ bool Table::assemble(const nall::string& statement) {
 
   if(s.match("instrument \"*\"")) {
     s.trim("instrument \"", "\"", 1L);
+    if(shared) {
+      definition = new Definition{*definition};
+      shared = false;
+    }
+    unsigned settings = definition->settings.size();
     parseTable(s);
+    applySettings(settings);
     return true;
   }
 
   unsigned pc = Architecture::pc();
 
-  for(auto& opcode : table) {
-    if(!tokenize(s, opcode.pattern)) continue;
+  //only opcodes sharing the statement's mnemonic can match; visit them in table order
+  nall::string name = s;
+  if(auto position = s.find(" ")) name.resize(position());
+  static const std::vector<unsigned> none;
+  auto& wildcards = definition->wildcards;
+  auto mnemonic = definition->mnemonics.find({name});
+  auto& candidates = mnemonic ? mnemonic->opcodes : none;
+
+  const Opcode* fallback = nullptr;
+  nall::vector<nall::string> fallbackArgs;
+
+  for(unsigned x = 0, y = 0; x < candidates.size() || y < wildcards.size();) {
+    unsigned index;
+    if(y == wildcards.size() || (x < candidates.size() && candidates[x] < wildcards[y])) {
+      index = candidates[x++];
+    } else {
+      index = wildcards[y++];
+    }
+    auto& opcode = definition->table[index];
+    if(!match(opcode, s)) continue;
 
     nall::vector<nall::string> args;
-    tokenize(args, s, opcode.pattern);
-    if(args.size() != opcode.number.size()) continue;
+    for(auto& span : spans) args.append(slice(s, span.offset, span.length));
 
     bool mismatch = false;
     for(auto& format : opcode.format) {
@@ -38,85 +78,206 @@ bool Table::assemble(const nall::string& statement) {
     }
     if(mismatch) continue;
 
-    for(auto& format : opcode.format) {
-      switch(format.type) {
-        case Format::Type::Static: {
-          writeBits(format.data, format.bits);
-          break;
-        }
+    //when converging, unsized arguments must fit the opcode; a later, wider opcode may take them
+    if(converging() && !fits(opcode, s, args)) {
+      if(!fallback) fallback = &opcode, fallbackArgs = args;
+      continue;
+    }
 
-        case Format::Type::Absolute: {
-          unsigned data = evaluate(args[format.argument]);
-          writeBits(data, opcode.number[format.argument].bits);
-          break;
-        }
+    assembleOpcode(opcode, args, pc);
+    return true;
+  }
 
-        case Format::Type::Relative: {
-          int data = evaluate(args[format.argument]) - (pc + format.displacement);
-          unsigned bits = opcode.number[format.argument].bits;
-          int min = -(1 << (bits - 1)), max = +(1 << (bits - 1)) - 1;
-          if(data < min || data > max) {
-            error("branch out of bounds: ", data);
-          }
-          writeBits(data, opcode.number[format.argument].bits);
-          break;
-        }
+  //nothing fit: keep the table's first choice
+  if(fallback) {
+    assembleOpcode(*fallback, fallbackArgs, pc);
+    return true;
+  }
 
-        case Format::Type::Repeat: {
-          unsigned data = evaluate(args[format.argument]);
-          for(unsigned n : nall::range(data)) {
-            writeBits(format.data, opcode.number[format.argument].bits);
-          }
-          break;
-        }
+  return false;
+}
 
-        case Format::Type::ShiftRight: {
-          uint64_t data = evaluate(args[format.argument]);
-          writeBits(data >> format.data, opcode.number[format.argument].bits);
-          break;
-        }
+void Table::assembleOpcode(const Opcode& opcode, nall::vector<nall::string>& args, unsigned pc) {
+  //a branch that does not reach takes the longer form named by its #relax line
+  if(opcode.relaxation && !relaxing) {
+    unsigned guesses = this->guesses();
+    bool outOfRange = this->outOfRange(opcode, args, pc);
+    if(relax(outOfRange, guesses != this->guesses())) return assembleRelaxation(opcode, args, pc);
+  }
 
-        case Format::Type::ShiftLeft: {
-          uint64_t data = evaluate(args[format.argument]);
-          writeBits(data << format.data, opcode.number[format.argument].bits);
-          break;
+  for(auto& format : opcode.format) {
+    switch(format.type) {
+      case Format::Type::Static: {
+        writeBits(format.data, format.bits);
+        break;
+      }
+
+      case Format::Type::Absolute: {
+        unsigned data = evaluate(args[format.argument]);
+        writeBits(data, opcode.number[format.argument].bits);
+        break;
+      }
+
+      case Format::Type::Relative: {
+        int data = evaluate(args[format.argument]) - (pc + format.displacement);
+        unsigned bits = opcode.number[format.argument].bits;
+        int min = -(1 << (bits - 1)), max = +(1 << (bits - 1)) - 1;
+        if(data < min || data > max) {
+          error("branch out of bounds: ", data);
         }
+        writeBits(data, opcode.number[format.argument].bits);
+        break;
+      }
 
-        case Format::Type::RelativeShiftRight: {
-          int data = evaluate(args[format.argument]) - (pc + format.displacement);
-          unsigned bits = opcode.number[format.argument].bits;
-          int min = -(1 << (bits - 1)), max = +(1 << (bits - 1)) - 1;
-          if(data < min || data > max) error("branch out of bounds");
-          bits -= format.data;
-          if (endian() == Bass::Endian::LSB) {
-            writeBits(data >> format.data, bits);
-          } else {
-            data >>= format.data;
-            writeBits(swapEndian(data, bits), bits);
-          }
-          break;
+      case Format::Type::Repeat: {
+        unsigned data = evaluate(args[format.argument]);
+        for(unsigned n : nall::range(data)) {
+          writeBits(format.data, opcode.number[format.argument].bits);
         }
+        break;
+      }
 
-        case Format::Type::Negative: {
-          unsigned data = evaluate(args[format.argument]);
-          writeBits(-data, opcode.number[format.argument].bits);
-          break;
+      case Format::Type::ShiftRight: {
+        uint64_t data = evaluate(args[format.argument]);
+        writeBits(data >> format.data, opcode.number[format.argument].bits);
+        break;
+      }
+
+      case Format::Type::ShiftLeft: {
+        uint64_t data = evaluate(args[format.argument]);
+        writeBits(data << format.data, opcode.number[format.argument].bits);
+        break;
+      }
+
+      case Format::Type::RelativeShiftRight: {
+        int data = evaluate(args[format.argument]) - (pc + format.displacement);
+        unsigned bits = opcode.number[format.argument].bits;
+        int min = -(1 << (bits - 1)), max = +(1 << (bits - 1)) - 1;
+        if(data < min || data > max) error("branch out of bounds");
+        bits -= format.data;
+        if (endian() == Bass::Endian::LSB) {
+          writeBits(data >> format.data, bits);
+        } else {
+          data >>= format.data;
+          writeBits(swapEndian(data, bits), bits);
         }
+        break;
+      }
 
-        case Format::Type::NegativeShiftRight: {
-          uint64_t data = evaluate(args[format.argument]);
-          writeBits(-data >> format.data, opcode.number[format.argument].bits);
-          break;
-        }        
+      case Format::Type::Negative: {
+        unsigned data = evaluate(args[format.argument]);
+        writeBits(-data, opcode.number[format.argument].bits);
+        break;
       }
-    }
 
-    return true;
+      case Format::Type::NegativeShiftRight: {
+        uint64_t data = evaluate(args[format.argument]);
+        writeBits(-data >> format.data, opcode.number[format.argument].bits);
+        break;
+      }        
+    }
   }
+}
 
+//whether any displacement of the opcode lies outside its field
+bool Table::outOfRange(const Opcode& opcode, nall::vector<nall::string>& args, unsigned pc) {
+  for(auto& format : opcode.format) {
+    if(format.type != Format::Type::Relative && format.type != Format::Type::RelativeShiftRight) continue;
+    int64_t data = evaluate(args[format.argument]) - (pc + format.displacement);
+    unsigned bits = opcode.number[format.argument].bits;
+    if(data < -(int64_t(1) << (bits - 1)) || data >= (int64_t(1) << (bits - 1))) return true;
+  }
   return false;
 }
 
+//each * of the #relax line takes the next argument, and @ the address of the relaxed opcode
+void Table::assembleRelaxation(const Opcode& opcode, nall::vector<nall::string>& args, unsigned pc) {
+  nall::string text;
+  unsigned argument = 0;
+  for(unsigned n : nall::range(opcode.relaxation.size())) {
+    char c = opcode.relaxation[n];
+    if(c == '*') {
+      if(argument == args.size()) error("too many arguments in relaxation: ", opcode.relaxation);
+      text.append(args[argument++]);
+    } else if(c == '@') {
+      text.append(pc);
+    } else {
+      text.append(c);
+    }
+  }
+
+  auto statements = text.split(";").strip();
+  relaxing = true;
+  for(auto& statement : statements) {
+    if(!assemble(statement)) error("unrecognized relaxation: ", statement);
+  }
+  relaxing = false;
+}
+
+//whether every unsized strong argument's value can be represented in its field, signed or unsigned
+//the size hints of args have already been stripped by the mismatch test, so they are read from the statement
+bool Table::fits(const Opcode& opcode, const nall::string& statement, nall::vector<nall::string>& args) {
+  for(auto& format : opcode.format) {
+    if(format.type != Format::Type::Absolute || format.match != Format::Match::Strong) continue;
+    auto& span = spans[format.argument];
+    nall::string text = slice(statement, span.offset, span.length);
+    if(bitLength(text)) continue;
+    unsigned bits = opcode.number[format.argument].bits;
+    if(!bits || bits >= 64) continue;
+    int64_t value = evaluate(args[format.argument]);
+    if(value < -(int64_t(1) << (bits - 1)) || value >= (int64_t(1) << bits)) return false;
+  }
+  return true;
+}
+
+//matches a statement against an opcode pattern of literal prefixes separated by wildcards,
+//recording the span captured by each wildcard.
+//each wildcard captures up to the earliest following occurrence of the next prefix;
+//this is the same result the backtracking nall::tokenize() finds, in a single left-to-right walk.
+bool Table::match(const Opcode& opcode, const nall::string& statement) {
+  const char* s = statement.data();
+  unsigned length = statement.size();
+  unsigned prefixes = opcode.prefix.size();
+  unsigned numbers = opcode.number.size();
+  spans.clear();
+
+  auto equal = [&](unsigned offset, const Prefix& prefix) -> bool {
+    return offset + prefix.size <= length && memcmp(s + offset, prefix.text.data(), prefix.size) == 0;
+  };
+
+  if(!prefixes || !equal(0, opcode.prefix[0])) return false;
+  unsigned offset = opcode.prefix[0].size;
+
+  for(unsigned n = 1; n <= numbers; n++) {
+    //trailing wildcard: captures the remainder of the statement
+    if(n == prefixes) {
+      spans.push_back({offset, length - offset});
+      return true;
+    }
+
+    auto& prefix = opcode.prefix[n];
+
+    //final prefix: must end the statement
+    if(n == prefixes - 1 && numbers < prefixes) {
+      if(length - offset < prefix.size) return false;
+      unsigned position = length - prefix.size;
+      if(!equal(position, prefix)) return false;
+      spans.push_back({offset, position - offset});
+      return true;
+    }
+
+    unsigned position = offset;
+    while(!equal(position, prefix)) {
+      if(position + prefix.size >= length) return false;
+      position++;
+    }
+    spans.push_back({offset, position - offset});
+    offset = position + prefix.size;
+  }
+
+  return offset == length;
+}
+
 unsigned Table::bitLength(nall::string& text) const {
   auto binLength = [&](const char* p) -> unsigned {
     unsigned length = 0;
@@ -173,8 +334,8 @@ bool Table::parseTable(const nall::string& text) {
     if(auto position = line.find("//")) line.resize(position());  //remove comments
 
     if(line[0] == '#') {
-      if(line == "#endian lsb") { setEndian(Bass::Endian::LSB); continue; }
-      if(line == "#endian msb") { setEndian(Bass::Endian::MSB); continue; }
+      if(line == "#endian lsb") { definition->settings.push_back({Setting::Type::Endian, Bass::Endian::LSB}); continue; }
+      if(line == "#endian msb") { definition->settings.push_back({Setting::Type::Endian, Bass::Endian::MSB}); continue; }
 
       if(auto position = line.find("#include ") ) {
         line.trimLeft("#include ", 1L);
@@ -182,6 +343,12 @@ bool Table::parseTable(const nall::string& text) {
         parseTable(more);
         continue;
       }
+      if(line.beginsWith("#relax ")) {
+        if(definition->table.empty()) error("#relax must follow the opcode it relaxes");
+        line.trimLeft("#relax ", 1L);
+        definition->table.back().relaxation = line.strip();
+        continue;
+      }
       if(auto position = line.find("#directive ") ) {
         parseDirective(line);
       }
@@ -193,7 +360,8 @@ bool Table::parseTable(const nall::string& text) {
     Opcode opcode;
     assembleTableLHS(opcode, part(0));
     assembleTableRHS(opcode, part(1));
-    table.push_back(opcode);
+    definition->table.push_back(opcode);
+    indexOpcode(definition->table.size() - 1);
   }
 
   return true;
@@ -214,14 +382,29 @@ void Table::parseDirective(nall::string& line) {
   
   unsigned value = atoi(items[1]);
   
-  for(auto& d : directives().EmitBytes) {
-    if(key.equals(d.token)) {
-      d.dataLength = value;
-      return;
+  definition->settings.push_back({Setting::Type::Directive, {}, key, value});
+}
+
+void Table::applySettings(unsigned offset) {
+  for(unsigned n = offset; n < definition->settings.size(); n++) {
+    auto& setting = definition->settings[n];
+
+    if(setting.type == Setting::Type::Endian) {
+      setEndian(setting.endian);
+    }
+
+    if(setting.type == Setting::Type::Directive) {
+      bool found = false;
+      for(auto& d : directives().EmitBytes) {
+        if(setting.token.equals(d.token)) {
+          d.dataLength = setting.dataLength;
+          found = true;
+          break;
+        }
+      }
+      if(!found) directives().add(setting.token, setting.dataLength);
     }
   }
-  
-  directives().add(key, value);
 }
 
 
@@ -356,6 +539,25 @@ void Table::assembleTableRHS(Opcode& opcode, const nall::string& text) {
   }
 }
 
+//the mnemonic is the literal text before the first space;
+//patterns that begin with (or run into) a wildcard could match any statement
+void Table::indexOpcode(unsigned index) {
+  auto& pattern = definition->table[index].pattern;
+  unsigned length = 0;
+  while(pattern[length] && pattern[length] != ' ' && pattern[length] != '*') length++;
+  if(length == 0 || pattern[length] == '*') {
+    definition->wildcards.push_back(index);
+    return;
+  }
+
+  nall::string name = slice(pattern, 0, length);
+  if(auto mnemonic = definition->mnemonics.find({name})) {
+    mnemonic->opcodes.push_back(index);
+  } else {
+    definition->mnemonics.insert({name})->opcodes.push_back(index);
+  }
+}
+
 uint64_t Table::swapEndian(uint64_t data, unsigned bits) {
   int t_data = 0;
   switch((bits - 1) / 8) {
@@ -36,16 +36,80 @@ private:
     std::vector<Number> number;
     std::vector<Format> format;
     nall::string pattern;
+    nall::string relaxation;  //#relax statements assembled instead when a displacement is out of range
   };
 
+  //opcodes grouped by the literal mnemonic that begins their pattern
+  struct Mnemonic {
+    Mnemonic() {}
+    Mnemonic(const nall::string& name) : name(name) {}
+
+    unsigned hash() const { return name.hash(); }
+    bool operator==(const Mnemonic& source) const { return name == source.name; }
+
+    nall::string name;
+    std::vector<unsigned> opcodes;
+  };
+
+  //#endian and #directive lines, replayed whenever the table is selected
+  struct Setting {
+    enum class Type : unsigned { Endian, Directive } type;
+    Bass::Endian endian;
+    nall::string token;
+    unsigned dataLength;
+  };
+
+  //the parsed form of a table and everything it includes
+  struct Definition {
+    std::vector<Opcode> table;
+    std::vector<Setting> settings;
+    nall::hashset<Mnemonic> mnemonics;  //opcodes whose pattern begins with a literal mnemonic
+    std::vector<unsigned> wildcards;    //opcodes whose pattern begins with a wildcard or space
+  };
+
+  //parsed definitions are shared by every Table built from the same table contents
+  struct Cache {
+    Cache() {}
+    Cache(const nall::string& key) : key(key) {}
+    Cache(const nall::string& key, const nall::shared_pointer<Definition>& definition) : key(key), definition(definition) {}
+
+    unsigned hash() const { return key.hash(); }
+    bool operator==(const Cache& source) const { return key == source.key; }
+
+    nall::string key;
+    nall::shared_pointer<Definition> definition;
+  };
+
+  struct Span {
+    unsigned offset;
+    unsigned length;
+  };
+
+  bool match(const Opcode& opcode, const nall::string& statement);
+  void assembleOpcode(const Opcode& opcode, nall::vector<nall::string>& args, unsigned pc);
+  bool fits(const Opcode& opcode, const nall::string& statement, nall::vector<nall::string>& args);
+  bool outOfRange(const Opcode& opcode, nall::vector<nall::string>& args, unsigned pc);
+  void assembleRelaxation(const Opcode& opcode, nall::vector<nall::string>& args, unsigned pc);
   unsigned bitLength(nall::string& text) const;
   void writeBits(uint64_t data, unsigned bits);
   bool parseTable(const nall::string& text);
   void parseDirective(nall::string& line);
   void assembleTableLHS(Opcode& opcode, const nall::string& text);
   void assembleTableRHS(Opcode& opcode, const nall::string& text);
+  void indexOpcode(unsigned index);
+  void applySettings(unsigned offset);
   uint64_t swapEndian(uint64_t data, unsigned bits);
 
-  std::vector<Opcode> table;
+  //cache.cpp
+  static nall::hashset<Cache>& cache();
+  void fingerprint(nall::Hash::SHA256& hash, const nall::string& text);
+  nall::string cacheLocation(const nall::string& key);
+  bool loadCache(const nall::string& key);
+  void saveCache(const nall::string& key);
+
+  nall::shared_pointer<Definition> definition;
+  bool shared = true;                 //definition is owned by the cache, and must be copied before it is modified
+  std::vector<Span> spans;            //arguments captured by the last successful match()
   uint64_t bitval, bitpos;
+  bool relaxing = false;              //assembling #relax statements, which must not relax again
 };
@@ -2,7 +2,10 @@
 //license: ISC
 //project started: 2013-09-27
 
-#include <set>
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <vector>
 
 #include <nall/intrinsics.hpp>
 #include <nall/memory.hpp>
@@ -28,32 +31,23 @@
 #include <nall/directory.hpp>
 #include <nall/path.hpp>
 #include <nall/hashset.hpp>
+#include <nall/flat-set.hpp>
 #include <nall/terminal.hpp>
 
 #include "bass.hpp"
+#include "architectures.hpp"
 #include "core/core.cpp"
 #include "architecture/table/table.cpp"
+#include "batch.hpp"
+#include "batch.cpp"
+#include "server.hpp"
+#include "server.cpp"
 
 #include <nall/arguments.hpp>
 #include <nall/main.hpp>
 
-void nall::main(Arguments arguments) {
-  if(!arguments) {
-    nall::print(stderr, "bass v18\n");
-    nall::print(stderr, "\n");
-    nall::print(stderr, "usage:\n");
-    nall::print(stderr, "  bass [options] source [source ...]\n");
-    nall::print(stderr, "\n");
-    nall::print(stderr, "options:\n");
-    nall::print(stderr, "  -o target        specify default output filename [overwrite]\n");
-    nall::print(stderr, "  -m target        specify default output filename [modify]\n");
-    nall::print(stderr, "  -d name[=value]  create define with optional value\n");
-    nall::print(stderr, "  -c name[=value]  create constant with optional value\n");
-    nall::print(stderr, "  -strict          upgrade warnings to errors\n");
-    nall::print(stderr, "  -benchmark       benchmark performance\n");
-    exit(EXIT_FAILURE);
-  }
-
+//one assembly, as given on the command line or on a line of a batch manifest
+static bool assemble(nall::Arguments arguments) {
   nall::string targetFilename;
   bool create = false;
   if(arguments.take("-o", targetFilename)) create = true;
@@ -67,12 +61,23 @@ void nall::main(Arguments arguments) {
   nall::string constant;
   while(arguments.take("-c", constant)) constants.append(constant);
 
+  nall::string cacheDirectory;
+  arguments.take("-cache", cacheDirectory);
+
+  bool converge = arguments.take("-converge");
   bool strict = arguments.take("-strict");
   bool benchmark = arguments.take("-benchmark");
+  bool annotate = arguments.take("-profile");
+  nall::string traceFilename;
+  arguments.take("-trace", traceFilename);
+  nall::string jobs;
+  arguments.take("-jobs", jobs);
+  nall::string incrementalDirectory;
+  arguments.take("-incremental", incrementalDirectory);
 
   if(arguments.find("-*")) {
     nall::print(stderr, "error: unrecognized argument(s)\n");
-    exit(EXIT_FAILURE);
+    return false;
   }
 
   nall::vector<nall::string> sourceFilenames;
@@ -80,6 +85,13 @@ void nall::main(Arguments arguments) {
 
   clock_t clockStart = clock();
   Bass bass;
+  bass.cache(cacheDirectory);
+  bass.converge(converge);
+  bass.benchmark(benchmark);
+  bass.annotate(annotate);
+  bass.trace(traceFilename);
+  bass.jobs(jobs.natural());
+  bass.incremental(incrementalDirectory);
   bass.target(targetFilename, create);
   for(auto& sourceFilename : sourceFilenames) {
     bass.source(sourceFilename);
@@ -94,10 +106,80 @@ void nall::main(Arguments arguments) {
   }
   if(!bass.assemble(strict)) {
     nall::print(stderr, "bass: assembly failed\n");
-    exit(EXIT_FAILURE);
+    return false;
   }
   clock_t clockFinish = clock();
   if(benchmark) {
     nall::print(stderr, "bass: assembled in ", (double)(clockFinish - clockStart) / CLOCKS_PER_SEC, " seconds\n");
   }
+  return true;
+}
+
+void nall::main(Arguments arguments) {
+  if(!arguments) {
+    nall::print(stderr, "bass v18\n");
+    nall::print(stderr, "\n");
+    nall::print(stderr, "usage:\n");
+    nall::print(stderr, "  bass [options] source [source ...]\n");
+    nall::print(stderr, "  bass -batch manifest [-jobs count]\n");
+    nall::print(stderr, "  bass -server socket\n");
+    nall::print(stderr, "  bass -client socket [options] source [source ...]\n");
+    nall::print(stderr, "\n");
+    nall::print(stderr, "options:\n");
+    nall::print(stderr, "  -o target        specify default output filename [overwrite]\n");
+    nall::print(stderr, "  -m target        specify default output filename [modify]\n");
+    nall::print(stderr, "  -d name[=value]  create define with optional value\n");
+    nall::print(stderr, "  -c name[=value]  create constant with optional value\n");
+    nall::print(stderr, "  -cache directory store parsed architecture tables in directory\n");
+    nall::print(stderr, "  -converge        repeat query passes until all constants are stable\n");
+    nall::print(stderr, "  -strict          upgrade warnings to errors\n");
+    nall::print(stderr, "  -benchmark       benchmark performance, and report where time was spent\n");
+    nall::print(stderr, "  -trace filename  write a chrome trace_event file of passes, sources and macros\n");
+    nall::print(stderr, "  -profile         list every source line with its execution count and time\n");
+    nall::print(stderr, "  -jobs count      write up to count output regions at once\n");
+    nall::print(stderr, "  -incremental dir keep output regions in dir, and write again only those that changed\n");
+    nall::print(stderr, "\n");
+    nall::print(stderr, "batch mode:\n");
+    nall::print(stderr, "  -batch manifest  assemble each line of manifest as a separate set of options and sources\n");
+    nall::print(stderr, "  -jobs count      with -batch: assemble up to count jobs at once\n");
+    nall::print(stderr, "\n");
+    nall::print(stderr, "server mode:\n");
+    nall::print(stderr, "  -server socket   assemble for clients connecting to socket, keeping sources and tables loaded\n");
+    nall::print(stderr, "  -client socket   assemble on the server listening on socket, or here if there is none\n");
+    exit(EXIT_FAILURE);
+  }
+
+  auto runner = [](const nall::vector<nall::string>& job) {
+    auto command = job;
+    command.prepend("bass");
+    return assemble(command);
+  };
+
+  nall::string manifest;
+  if(arguments.take("-batch", manifest)) {
+    nall::string jobs;
+    arguments.take("-jobs", jobs);
+    Batch batch;
+    if(!batch.load(manifest) || !batch.run(jobs.natural(), runner)) exit(EXIT_FAILURE);
+    return;
+  }
+
+  nall::string socket;
+  if(arguments.take("-server", socket)) {
+    Server server;
+    if(!server.listen(socket) || !server.serve(runner)) exit(EXIT_FAILURE);
+    return;
+  }
+
+  //with no server listening on the socket, the assembly runs here instead
+  if(arguments.take("-client", socket)) {
+    nall::vector<nall::string> job;
+    for(auto& argument : arguments) job.append(argument);
+    if(auto succeeded = Server::submit(socket, job)) {
+      if(!succeeded()) exit(EXIT_FAILURE);
+      return;
+    }
+  }
+
+  if(!assemble(arguments)) exit(EXIT_FAILURE);
 }
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "core/image.hpp"
 #include "core/core.hpp"
 #include "architecture/architecture.hpp"
 #include "architecture/table/table.hpp"
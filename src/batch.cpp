@@ -0,0 +1,212 @@
+//a manifest lists one job per line, as the arguments bass would be given on the command line.
+//arguments containing spaces are quoted, and // starts a comment.
+bool Batch::load(const nall::string& manifest) {
+  if(!nall::file::exists(manifest)) {
+    nall::print(stderr, "error: batch manifest not found: ", manifest, "\n");
+    return false;
+  }
+
+  this->manifest = manifest;
+  auto lines = nall::string::read(manifest).split("\n");
+  for(unsigned lineNumber : nall::range(lines.size())) {
+    auto line = lines[lineNumber];
+    line.transform("\t\r", "  ");
+    if(auto position = line.qfind("//")) line.resize(position());
+
+    Job job;
+    job.line = 1 + lineNumber;
+    for(auto argument : line.qsplit(" ")) {
+      argument.strip();
+      if(!argument) continue;
+      if(argument.match("\"*\"")) argument.trim("\"", "\"", 1L);
+      job.arguments.append(argument);
+    }
+    if(job.arguments) jobs.append(job);
+  }
+  return true;
+}
+
+bool Batch::run(unsigned workers, const Runner& runner) {
+  auto start = std::chrono::steady_clock::now();
+  workers = std::min<unsigned>(std::max(workers, 1u), jobs.size());
+
+  //even a single worker keeps a job that crashes from taking the rest of the batch with it
+  bool pooled = workers && runPool(workers, runner);
+  if(!pooled) {
+    workers = 1;
+    for(auto& job : jobs) {
+      execute(job, runner);
+      report(job);
+    }
+  }
+
+  unsigned failed = 0;
+  for(auto& job : jobs) failed += !job.succeeded;
+  char seconds[32];
+  snprintf(seconds, sizeof(seconds), "%.3f", std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+  nall::print(stderr, "bass: ", jobs.size(), " job(s), ", failed, " failed, ", workers, " worker(s), ", seconds, " seconds\n");
+  return !failed;
+}
+
+void Batch::execute(Job& job, const Runner& runner) {
+  auto wall = std::chrono::steady_clock::now();
+  auto cpu = clock();
+  job.succeeded = runner(job.arguments);
+  job.wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall).count();
+  job.cpu = double(clock() - cpu) / CLOCKS_PER_SEC;
+  job.finished = true;
+}
+
+bool Batch::runPool(unsigned count, const Runner& runner) {
+  #if defined(API_POSIX)
+  nall::string pattern{nall::Path::temporary(), "bass-XXXXXX"};
+  if(!mkdtemp(pattern.get())) return false;
+  directory = {pattern, "/"};
+
+  int results[2];
+  if(pipe(results) < 0) {
+    nall::inode::remove(directory);
+    return false;
+  }
+  signal(SIGPIPE, SIG_IGN);
+  fflush(stderr);
+
+  nall::vector<Worker> workers;
+  workers.resize(count);
+  auto spawn = [&](unsigned n) {
+    int control[2];
+    if(pipe(control) < 0) return;
+    int pid = fork();
+    if(pid < 0) {
+      close(control[0]);
+      close(control[1]);
+      return;
+    }
+    if(!pid) {
+      close(control[1]);
+      close(results[0]);
+      for(auto& worker : workers) if(worker.control >= 0) close(worker.control);
+      work(n, control[0], results[1], runner);
+    }
+    close(control[0]);
+    workers[n] = {pid, control[1]};
+  };
+  for(unsigned n : nall::range(count)) spawn(n);
+
+  //jobs are handed out one at a time, so that a worker that finishes early takes on the next one
+  unsigned next = 0;
+  auto dispatch = [&](Worker& worker) {
+    if(next == jobs.size() || worker.control < 0) return;
+    unsigned job = next;
+    if(::write(worker.control, &job, sizeof(job)) != sizeof(job)) return;
+    worker.job = job;
+    next++;
+  };
+  auto collect = [&](unsigned job) {
+    nall::string log{directory, job, ".log"};
+    nall::string output{directory, job, ".out"};
+    jobs[job].log = nall::file::read(log);
+    jobs[job].output = nall::file::read(output);
+    nall::inode::remove(log);
+    nall::inode::remove(output);
+    jobs[job].finished = true;
+  };
+  auto busy = [&] {
+    for(auto& worker : workers) if(worker.job >= 0) return true;
+    return false;
+  };
+
+  for(auto& worker : workers) dispatch(worker);
+  while(busy()) {
+    pollfd descriptor{results[0], POLLIN, 0};
+    if(poll(&descriptor, 1, 100) > 0) {
+      Result result;
+      if(read(results[0], &result, sizeof(result)) == sizeof(result) && result.worker < workers.size()) {
+        auto& job = jobs[result.job];
+        job.succeeded = result.succeeded;
+        job.wall = result.wall;
+        job.cpu = result.cpu;
+        collect(result.job);
+        workers[result.worker].job = -1;
+        dispatch(workers[result.worker]);
+        while(reported < jobs.size() && jobs[reported].finished) report(jobs[reported++]);
+        continue;
+      }
+    }
+
+    //a worker that stops takes its job with it, and is replaced
+    int status = 0;
+    for(int pid; (pid = waitpid(-1, &status, WNOHANG)) > 0;) {
+      for(unsigned n : nall::range(workers.size())) {
+        auto& worker = workers[n];
+        if(worker.pid != pid) continue;
+        worker.pid = 0;
+        close(worker.control);
+        worker.control = -1;
+        if(worker.job < 0) continue;
+        collect(worker.job);
+        if(WIFSIGNALED(status)) jobs[worker.job].log.append("error: assembly stopped by signal ", WTERMSIG(status), "\n");
+        worker.job = -1;
+        spawn(n);
+        dispatch(worker);
+      }
+    }
+    while(reported < jobs.size() && jobs[reported].finished) report(jobs[reported++]);
+  }
+
+  //should every worker have stopped, the jobs never handed out fail
+  for(; next < jobs.size(); next++) {
+    jobs[next].finished = true;
+    jobs[next].log = "error: no worker left to assemble this job\n";
+  }
+  while(reported < jobs.size()) report(jobs[reported++]);
+
+  for(auto& worker : workers) {
+    if(worker.control >= 0) close(worker.control);
+    if(worker.pid) waitpid(worker.pid, nullptr, 0);
+  }
+  close(results[0]);
+  close(results[1]);
+  nall::inode::remove(directory);
+  return true;
+  #else
+  return false;
+  #endif
+}
+
+//a worker assembles the jobs it is sent until its pipe is closed
+void Batch::work(unsigned worker, int control, int results, const Runner& runner) {
+  #if defined(API_POSIX)
+  //output written to stdout by a job without a target is kept, like its diagnostics, rather than interleaved
+  unsigned index = 0;
+  while(read(control, &index, sizeof(index)) == sizeof(index) && index < jobs.size()) {
+    int log = open(nall::string{directory, index, ".log"}, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if(log >= 0) {
+      dup2(log, STDERR_FILENO);
+      close(log);
+    }
+    int output = open(nall::string{directory, index, ".out"}, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if(output >= 0) {
+      dup2(output, STDOUT_FILENO);
+      close(output);
+    }
+    auto& job = jobs[index];
+    execute(job, runner);
+    fflush(stdout);
+    fflush(stderr);
+    Result result{index, worker, job.succeeded, job.wall, job.cpu};
+    if(::write(results, &result, sizeof(result)) != sizeof(result)) break;
+  }
+  #endif
+  _exit(EXIT_SUCCESS);
+}
+
+void Batch::report(Job& job) {
+  //a job run in place writes nothing to a terminal, and neither does one run by a worker
+  if(job.output && !isatty(fileno(stdout))) fwrite(job.output.data(), 1, job.output.size(), stdout);
+  if(job.log) fwrite(job.log.data(), 1, job.log.size(), stderr);
+  char times[64];
+  snprintf(times, sizeof(times), "%10.3f ms %10.3f ms cpu", job.wall * 1000.0, job.cpu * 1000.0);
+  nall::print(stderr, "bass: ", manifest, ":", job.line, ": ", job.succeeded ? "ok    " : "failed",
+    times, "  ", job.arguments.merge(" "), "\n");
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#if defined(API_POSIX)
+  #include <poll.h>
+#endif
+
+//-batch: assembles every job listed in a manifest, each in the manner of one bass command line.
+//jobs are handed to a pool of worker processes as each one becomes idle; a worker keeps the
+//architecture tables and source files it has parsed for the jobs that follow.
+struct Batch {
+  //assembles one job from its command line arguments, reporting diagnostics on stderr
+  using Runner = nall::function<bool (const nall::vector<nall::string>& arguments)>;
+
+  bool load(const nall::string& manifest);
+  bool run(unsigned workers, const Runner& runner);
+
+private:
+  struct Job {
+    unsigned line = 0;                      //in the manifest
+    nall::vector<nall::string> arguments;
+    bool finished = false;
+    bool succeeded = false;
+    double wall = 0;  //seconds
+    double cpu = 0;   //seconds
+    nall::string log; //diagnostics, when run by a worker
+    nall::vector<uint8_t> output;  //written to stdout by a job without a target, when run by a worker
+  };
+
+  //what a worker sends back for each job; small enough to be written to a pipe atomically
+  struct Result {
+    unsigned job;
+    unsigned worker;
+    bool succeeded;
+    double wall;
+    double cpu;
+  };
+
+  struct Worker {
+    int pid = 0;
+    int control = -1;  //write end of the pipe the worker reads job numbers from; closing it stops the worker
+    int job = -1;      //job being assembled, or -1 when idle
+  };
+
+  void execute(Job& job, const Runner& runner);
+  bool runPool(unsigned workers, const Runner& runner);
+  [[noreturn]] void work(unsigned worker, int control, int results, const Runner& runner);
+  void report(Job& job);
+
+  nall::string manifest;
+  nall::vector<Job> jobs;
+  unsigned reported = 0;  //jobs are reported in the order they are listed, as soon as all before them finish
+  nall::string directory;  //diagnostics and output captured by the workers
+};
@@ -7,6 +7,13 @@ bool Bass::analyze() {
     if(!analyzeInstruction(i)) error("unrecognized directive: ", i.lineNumber, ": ", i.statement);
   }
 
+  //classify each statement once, so that execute() does not need to pattern match it on every pass
+  for(auto& i : program) {
+    auto open = i.statement.find("{");
+    i.dynamic = open && i.statement.findFrom(open() + 1, "}");
+    if(!i.dynamic) i.directives = analyzeDirectives(i.statement);
+  }
+
   return true;
 }
 
@@ -132,3 +139,216 @@ bool Bass::analyzeInstruction(Instruction& i) {
 
   return true;
 }
+
+//statements that may fall through to later directives (eg an invocation of an undefined macro)
+//are followed by the next matching directive; the final directive always accepts the statement
+nall::vector<Bass::Directive> Bass::analyzeDirectives(const nall::string& statement) {
+  nall::vector<Directive> directives;
+  auto type = Directive::Type::Unknown;
+  while(true) {
+    directives.append(analyzeDirective(statement, type));
+    type = directives.right().type;
+    if(type != Directive::Type::ArrayAssign
+    && type != Directive::Type::Invoke
+    && type != Directive::Type::Copy
+    && type != Directive::Type::Tracker
+    ) break;
+  }
+  return directives;
+}
+
+//returns the first directive after the given type that matches the statement
+Bass::Directive Bass::analyzeDirective(const nall::string& statement, Directive::Type after) {
+  using Type = Directive::Type;
+  Directive d;
+  nall::string s = statement;
+
+  d.global = s.beginsWith("global ");
+  d.parent = s.beginsWith("parent ");
+  if(d.global) s.trimLeft("global ", 1L);
+  if(d.parent) s.trimLeft("parent ", 1L);
+  d.statement = s;
+
+  auto is = [&](Type type, bool matched) -> bool {
+    if(after >= type || !matched) return false;
+    d.type = type;
+    return true;
+  };
+  auto& o = d.operands;
+
+  if(is(Type::Exit, s.equals("exit"))) return d;
+
+  if(is(Type::Macro, s.match("macro ?*(*) {"))) {
+    o = s.trim("macro ", ") {", 1L).split("(", 1L).strip();
+    return d;
+  }
+
+  if(is(Type::Inline, s.match("inline ?*(*) {"))) {
+    o = s.trim("inline ", ") {", 1L).split("(", 1L).strip();
+    return d;
+  }
+
+  if(is(Type::DefineFunction, s.match("define ?*(*)*"))) {
+    auto e = s.trimLeft("define ", 1L).split("=", 1L).strip();
+    o = e(0).trimRight(")", 1L).split("(", 1L).strip();
+    o.resize(2);
+    o.append(e(1));
+    return d;
+  }
+
+  if(is(Type::Define, s.match("define ?*"))) {
+    o = s.trimLeft("define ", 1L).split("=", 1L).strip();
+    return d;
+  }
+
+  if(is(Type::Evaluate, s.match("evaluate ?*"))) {
+    o = s.trimLeft("evaluate ", 1L).split("=", 1L).strip();
+    return d;
+  }
+
+  if(is(Type::ExpressionFunction, s.match("expression ?*(*)*"))) {
+    auto e = s.trimLeft("expression ", 1L).split("=", 1L).strip();
+    o = e(0).trimRight(")", 1L).split("(", 1L).strip();
+    o.resize(2);
+    o.append(e(1));
+    return d;
+  }
+
+  if(is(Type::Variable, s.match("variable ?*"))) {
+    o = s.trimLeft("variable ", 1L).split("=", 1L).strip();
+    return d;
+  }
+
+  if(is(Type::Array, s.match("array[?*] ?*"))) {
+    auto a = s.trimLeft("array[", 1L).split("]", 1L);
+    o = a(1).split("=", 1L).strip();
+    o.resize(2);
+    o.prepend(a(0));
+    return d;
+  }
+
+  if(is(Type::ArrayAssign, s.match("?*[?*] = ?*"))) {
+    auto a = s.split("[", 1L).strip();
+    auto b = a(1).split("]", 1L).strip();
+    auto c = b(1).split("=", 1L).strip();
+    o = {a(0), b(0), c(1)};
+    return d;
+  }
+
+  if(is(Type::If, s.match("if ?* {"))) {
+    o.append(s.trim("if ", " {", 1L).strip());
+    return d;
+  }
+
+  if(is(Type::ElseIf, s.match("} else if ?* {"))) {
+    o.append(s.trim("} else if ", " {", 1L).strip());
+    return d;
+  }
+
+  if(is(Type::Else, s.match("} else {"))) return d;
+  if(is(Type::EndIf, s.match("} endif"))) return d;
+
+  if(is(Type::While, s.match("while ?* {"))) {
+    o.append(s.trim("while ", " {", 1L).strip());
+    return d;
+  }
+
+  if(is(Type::EndWhile, s.match("} endwhile"))) return d;
+
+  if(is(Type::Invoke, s.match("?*(*)"))) {
+    o = nall::string{s}.trimRight(")", 1L).split("(", 1L).strip();
+    return d;
+  }
+
+  if(is(Type::EndMacro, s.match("} endmacro") || s.match("} endinline"))) return d;
+
+  if(is(Type::Block, s.match("block {") || s.match("} endblock"))) return d;
+
+  if(is(Type::Namespace, s.match("namespace ?* {"))) {
+    o.append(s.trim("namespace ", "{", 1L).strip());
+    return d;
+  }
+
+  if(is(Type::EndNamespace, s.match("} endnamespace"))) return d;
+
+  if(is(Type::Function, s.match("function ?* {"))) {
+    o.append(s.trim("function ", "{", 1L).strip());
+    return d;
+  }
+
+  if(is(Type::EndFunction, s.match("} endfunction"))) return d;
+
+  if(is(Type::Constant, s.match("constant ?*"))) {
+    if(s.match("*(*")) {
+      o = s.trim("constant ", ")").split("(");
+    } else {
+      o = s.trimLeft("constant ", 1L).split("=", 1L).strip();
+    }
+    return d;
+  }
+
+  if(is(Type::Label, s.match("?*:") || s.match("?*: {"))) {
+    s.trimRight(" {", 1L);
+    s.trimRight(":", 1L);
+    o.append(s);
+    return d;
+  }
+
+  if(is(Type::LastLabel, s.match("-") || s.match("- {"))) return d;
+  if(is(Type::NextLabel, s.match("+") || s.match("+ {"))) return d;
+  if(is(Type::EndConstant, s.match("} endconstant"))) return d;
+
+  if(is(Type::Output, s.match("output ?*"))) {
+    o.append(s.trimLeft("output ", 1L));
+    return d;
+  }
+
+  if(is(Type::Architecture, s.match("architecture ?*") || s.match("arch ?*"))) {
+    s.trimLeft("architecture ", 1L);
+    s.trimLeft("arch ", 1L);
+    o.append(s);
+    return d;
+  }
+
+  struct Prefixed { Type type; const char* pattern; const char* prefix; };
+  static const Prefixed prefixed[] = {
+    {Type::Endian,  "endian ?*",  "endian "},
+    {Type::Origin,  "origin ?*",  "origin "},
+    {Type::Base,    "base ?*",    "base "},
+    {Type::Enqueue, "enqueue ?*", "enqueue "},
+    {Type::Dequeue, "dequeue ?*", "dequeue "},
+    {Type::Copy,    "copy ?*",    "copy "},
+    {Type::Insert,  "insert ?*",  "insert "},
+    {Type::Delete,  "delete ?*",  "delete "},
+    {Type::Fill,    "fill ?*",    "fill "},
+    {Type::Map,     "map ?*",     "map "},
+    {Type::Ds,      "ds ?*",      "ds "},
+  };
+  for(auto& p : prefixed) {
+    if(is(p.type, s.match(p.pattern))) {
+      o.append(nall::string{s}.trimLeft(p.prefix, 1L));
+      return d;
+    }
+  }
+
+  if(is(Type::Tracker, s.match("tracker ?*"))) {
+    o.append(nall::string{s}.trimLeft("tracker ", 1L).strip());
+    return d;
+  }
+
+  static const Prefixed messages[] = {
+    {Type::Print,   "print ?*",   "print "},
+    {Type::Notice,  "notice ?*",  "notice "},
+    {Type::Warning, "warning ?*", "warning "},
+    {Type::Error,   "error ?*",   "error "},
+  };
+  for(auto& p : messages) {
+    if(is(p.type, s.match(p.pattern))) {
+      o.append(nall::string{s}.trimLeft(p.prefix, 1L).strip());
+      return d;
+    }
+  }
+
+  d.type = Type::Instruction;
+  return d;
+}
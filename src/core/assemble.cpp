@@ -9,128 +9,127 @@ void Bass::initialize() {
   nextLabelCounter = 1;
 }
 
-bool Bass::assemble(const nall::string& statement) {
-  nall::string s = statement;
+bool Bass::assemble(const Directive& d) {
+  using Type = Directive::Type;
+  static const nall::string none;
+  auto o = [&](unsigned n) -> const nall::string& { return d.operands(n, none); };
 
-  if(s.match("block {")) return true;
-  if(s.match("} endblock")) return true;
+  switch(d.type) {
+
+  //block {
+  //}
+  case Type::Block: {
+    return true;
+  }
 
   //namespace name {
-  if(s.match("namespace ?* {")) {
-    s.trim("namespace ", "{", 1L).strip();
-    if(!validate(s)) error("invalid namespace specifier: ", s);
-    scope.append(s);
+  case Type::Namespace: {
+    if(!validate(o(0))) error("invalid namespace specifier: ", o(0));
+    enterScope(o(0));
     return true;
   }
 
   //}
-  if(s.match("} endnamespace")) {
-    scope.removeRight();
+  case Type::EndNamespace: {
+    leaveScope();
     return true;
   }
 
   //function name {
-  if(s.match("function ?* {")) {
-    s.trim("function ", "{", 1L).strip();
-    setConstant(s, pc());
-    scope.append(s);
+  case Type::Function: {
+    setConstant(o(0), pc());
+    enterScope(o(0));
     return true;
   }
 
   //}
-  if(s.match("} endfunction")) {
-    scope.removeRight();
+  case Type::EndFunction: {
+    leaveScope();
     return true;
   }
 
   //constant name(value)
   //or
   //constant name = value
-  if(s.match("constant ?*")) {
-    if (s.match("*(*")){
-      auto p = s.trim("constant ", ")").split("(");
-      setConstant(p(0), evaluate(p(1)));
-    }
-      else {
-        auto p = s.trimLeft("constant ", 1L).split("=", 1L).strip();
-        setConstant(p(0), evaluate(p(1)));
-    }
+  case Type::Constant: {
+    setConstant(o(0), evaluate(o(1)));
     return true;
   }
 
   //label: or label: {
-  if(s.match("?*:") || s.match("?*: {")) {
-    s.trimRight(" {", 1L);
-    s.trimRight(":", 1L);
-    setConstant(s, pc());
+  case Type::Label: {
+    setConstant(o(0), pc());
     return true;
   }
 
   //- or - {
-  if(s.match("-") || s.match("- {")) {
+  case Type::LastLabel: {
     setConstant({"lastLabel#", lastLabelCounter++}, pc());
     return true;
   }
 
   //+ or + {
-  if(s.match("+") || s.match("+ {")) {
+  case Type::NextLabel: {
     setConstant({"nextLabel#", nextLabelCounter++}, pc());
     return true;
   }
 
   //}
-  if(s.match("} endconstant")) {
+  case Type::EndConstant: {
     return true;
   }
 
   //output "filename" [, create]
-  if(s.match("output ?*")) {
-    auto p = split(s.trimLeft("output ", 1L));
+  case Type::Output: {
+    auto p = split(o(0));
     if(!p(0).match("\"*\"")) error("missing filename");
     nall::string filename = {filepath(), text(p.take(0))};
     bool create = (p.size() && p(0) == "create");
+    if(writePhase() && regionBoundary()) return true;
+    if(queryPhase()) forkRegion();
     target(filename, create);
+    if(queryPhase()) {
+      Event event{Event::Type::Target, filename};
+      event.create = create;
+      events.append(event);
+    }
     return true;
   }
 
   //architecture name
-  if(s.match("architecture ?*") || s.match("arch ?*")) {
-    s.trimLeft("architecture ", 1L);
-    s.trimLeft("arch ", 1L);
-
-    if(s == "none") architecture = new Architecture{*this};
+  case Type::Architecture: {
+    if(tracing.enable) traceArchitecture();
+    if(o(0) == "none") architecture = new Architecture{*this};
     else {
-      architecture = new Table{*this, readArchitecture(s)};
+      architecture = new Table{*this, readArchitecture(o(0))};
     }
+    architectureName = o(0);
     return true;
   }
 
   //endian (lsb|msb)
-  if(s.match("endian ?*")) {
-    s.trimLeft("endian ", 1L);
-    if(s == "lsb") { endian = Endian::LSB; return true; }
-    if(s == "msb") { endian = Endian::MSB; return true; }
+  case Type::Endian: {
+    if(o(0) == "lsb") { endian = Endian::LSB; return true; }
+    if(o(0) == "msb") { endian = Endian::MSB; return true; }
     error("invalid endian mode");
   }
 
   //origin offset
-  if(s.match("origin ?*")) {
-    s.trimLeft("origin ", 1L);
-    origin = evaluate(s);
+  case Type::Origin: {
+    origin = evaluate(o(0));
     seek(origin);
     return true;
   }
 
   //base offset
-  if(s.match("base ?*")) {
-    s.trimLeft("base ", 1L);
-    base = evaluate(s) - origin;
+  case Type::Base: {
+    base = evaluate(o(0)) - origin;
     return true;
   }
 
   //enqueue variable [, ...]
-  if(s.match("enqueue ?*")) {
-    auto p = split(s.trimLeft("enqueue ", 1L));
+  case Type::Enqueue: {
+    auto p = split(o(0));
     for(auto& t : p) {
       if(t == "origin") {
         queue.append(origin);
@@ -147,8 +146,8 @@ bool Bass::assemble(const nall::string& statement) {
   }
 
   //dequeue variable [, ...]
-  if(s.match("dequeue ?*")) {
-    auto p = split(s.trimLeft("dequeue ", 1L));
+  case Type::Dequeue: {
+    auto p = split(o(0));
     for(auto& t : p) {
       if(t == "origin") {
         origin = queue.takeRight().natural();
@@ -167,49 +166,53 @@ bool Bass::assemble(const nall::string& statement) {
   }
 
   //copy source, target, length
-  if(s.match("copy ?*")) {
-    auto p = split(s.trimLeft("copy ", 1L));
+  case Type::Copy: {
+    auto p = split(o(0));
     if(p.size() == 3) {
+      if(queryPhase()) replayable = false;  //reads back the target file
       auto origin = targetFile.offset();
       auto source = evaluate(p(0));
       auto target = evaluate(p(1));
       auto length = evaluate(p(2));
       nall::vector<uint8_t> memory;
       memory.resize(length);
+      recordTargetRead();
       targetFile.seek(source);
       targetFile.read(memory);
       targetFile.seek(target);
-      for(unsigned offset : nall::range(length)) write(memory[offset]);
+      write(memory);
       targetFile.seek(origin);
       return true;
     }
+    return false;
   }
 
   //insert [name, ] filename [, offset] [, length]
-  if(s.match("insert ?*")) {
-    auto p = split(s.trimLeft("insert ", 1L));
+  case Type::Insert: {
+    if(queryPhase()) replayable = false;  //the file may be one an earlier output wrote
+    auto p = split(o(0));
     nall::string name;
     if(!p(0).match("\"*\"")) name = p.take(0);
     if(!p(0).match("\"*\"")) error("missing filename");
     nall::string filename = {filepath(), text(p.take(0))};
-    auto fp = nall::file::open(filename, nall::file::mode::read);
-    if(!fp) error("file not found: ", filename);
+    if(!nall::file::exists(filename)) error("file not found: ", filename);
+    unsigned size = nall::file::size(filename);
     unsigned offset = p.size() ? evaluate(p.take(0)) : 0;
-    if(offset > fp.size()) offset = fp.size();
+    if(offset > size) offset = size;
     unsigned length = p.size() ? evaluate(p.take(0)) : 0;
-    if(length == 0) length = fp.size() - offset;
+    if(length == 0) length = size - offset;
     if(name) {
       setConstant({name}, pc());
       setConstant({name, ".size"}, length);
     }
-    fp.seek(offset);
-    while(!fp.end() && length--) write(fp.read());
+    write(readFile(filename, offset, std::min(length, size - offset)));
     return true;
   }
 
   //delete filename
-  if(s.match("delete ?*")) {
-    auto p = split(s.trimLeft("delete ", 1L));
+  case Type::Delete: {
+    if(queryPhase()) replayable = false;  //runs in both passes
+    auto p = split(o(0));
     if(!p(0).match("\"*\"")) error("missing filename");
     nall::string filename = {filepath(), text(p.take(0))};
     if(!nall::file::exists(filename)) {
@@ -224,17 +227,17 @@ bool Bass::assemble(const nall::string& statement) {
   }
 
   //fill length [, with]
-  if(s.match("fill ?*")) {
-    auto p = split(s.trimLeft("fill ", 1L));
+  case Type::Fill: {
+    auto p = split(o(0));
     unsigned length = evaluate(p(0));
     unsigned byte = evaluate(p(1, "0"));
-    while(length--) write(byte);
+    fill(byte, length);
     return true;
   }
 
   //map 'char' [, value] [, length]
-  if(s.match("map ?*")) {
-    auto p = split(s.trimLeft("map ", 1L));
+  case Type::Map: {
+    auto p = split(o(0));
     uint8_t index = evaluate(p(0));
     int64_t value = evaluate(p(1, "0"));
     int64_t length = evaluate(p(2, "1"));
@@ -244,20 +247,22 @@ bool Bass::assemble(const nall::string& statement) {
     return true;
   }
 
+  }
+
   //d[bwldq] ("string"|variable) [, ...]
+  //the emit directives can be redefined by architectures, so these are matched at run-time
   unsigned dataLength = 0;
   unsigned tokenLength = 0;
-  for(auto& d : directives.EmitBytes) {
+  for(auto& e : directives.EmitBytes) {
     // make sure to have & consume a space
-    if(s.beginsWith(d.token)) {
-      dataLength = d.dataLength;
-      tokenLength = d.token.length();
+    if(d.statement.beginsWith(e.token)) {
+      dataLength = e.dataLength;
+      tokenLength = e.token.length();
       break;
     }
   }
   if(dataLength) {
-    s = slice(s, tokenLength);  //remove prefix +space
-    auto p = split(s);
+    auto p = split(slice(d.statement, tokenLength));  //remove prefix +space
     for(auto& t : p) {
       if(t.match("\"*\"")) {
         t = text(t);
@@ -269,71 +274,81 @@ bool Bass::assemble(const nall::string& statement) {
     return true;
   }
 
+  switch(d.type) {
+
   //ds amount
-  if(s.match("ds ?*")) {
-    s.trimLeft("ds ", 1L);
-    origin += evaluate(s);
+  case Type::Ds: {
+    origin += evaluate(o(0));
     seek(origin);
     return true;
   }
 
   //tracker enable|disable|reset
-  if(s.match("tracker ?*")) {
-    s.trimLeft("tracker ", 1L).strip();
-    if(s == "enable") {
+  case Type::Tracker: {
+    if(queryPhase()) replayable = false;  //overwrites are reported from the write pass
+    if(o(0) == "enable") {
       if(writePhase()) tracker.enable = true;
       return true;
     }
-    if(s == "disable") {
+    if(o(0) == "disable") {
       if(writePhase()) tracker.enable = false;
       return true;
     }
-    if(s == "reset") {
-      if(writePhase()) tracker.addresses.clear();
+    if(o(0) == "reset") {
+      if(writePhase()) tracker.ranges.clear();
       return true;
     }
+    return false;
   }
 
   //print ("string"|[cast:]variable) [, ...]
-  if(s.match("print ?*")) {
+  case Type::Print: {
     if(writePhase()) {
-      s.trimLeft("print ", 1L).strip();
-      print(stderr, assembleString(s));
+      print(stderr, assembleString(o(0)));
+    }
+    if(queryPhase() && replayable) {
+      auto message = assembleString(o(0));
+      if(replayable) events.append({Event::Type::Print, message});
     }
     return true;
   }
 
   //notice ("string"|[cast:]variable) [, ...]
-  if(s.match("notice ?*")) {
+  case Type::Notice: {
+    if(queryPhase()) replayable = false;
     if(writePhase()) {
-      s.trimLeft("notice ", 1L).strip();
-      notice(assembleString(s));
+      notice(assembleString(o(0)));
     }
     return true;
   }
 
   //warning ("string"|[cast:]variable) [, ...]
-  if(s.match("warning ?*")) {
+  case Type::Warning: {
+    if(queryPhase()) replayable = false;
     if(writePhase()) {
-      s.trimLeft("warning ", 1L).strip();
-      warning(assembleString(s));
+      warning(assembleString(o(0)));
     }
     return true;
   }
 
   //error ("string"|[cast:]variable) [, ...]
-  if(s.match("error ?*")) {
+  case Type::Error: {
+    if(queryPhase()) replayable = false;
     if(writePhase()) {
-      s.trimLeft("error ", 1L).strip();
-      error(assembleString(s));
+      error(assembleString(o(0)));
     }
     return true;
   }
 
+  }
+
   charactersUseMap = true;
-  bool result = architecture->assemble(statement);
+  auto start = profile.enable ? Timing::Clock::now() : Timing::Clock::time_point{};
+  bool result = architecture->assemble(d.statement);
+  if(profile.enable && result) profile.architectures[architectureName].add(start);
   charactersUseMap = false;
-  return result;
+  if(!result) evaluate(d.statement);
+  return true;
 }
 
 nall::string Bass::assembleString(const nall::string& parameters) {
@@ -1,22 +1,36 @@
+#include "image.cpp"
 #include "evaluate.cpp"
 #include "analyze.cpp"
 #include "execute.cpp"
 #include "assemble.cpp"
 #include "utility.cpp"
+#include "profile.cpp"
+#include "parallel.cpp"
+#include "incremental.cpp"
 
 bool Bass::target(const nall::string& filename, bool create) {
-  if(targetFile) targetFile.close();
+  if(targetFile) {
+    if(parallel.worker) saveTarget();
+    targetFile.close();
+  }
   if(!filename) return true;
 
+  //a worker records what was asked for: whether the file exists is up to the regions before it
+  parallel.targetCreated = create;
+
   //cannot modify a file unless it exists
   if(!nall::file::exists(filename)) create = true;
 
-  if(!targetFile.open(filename, create ? nall::file::mode::write : nall::file::mode::modify)) {
+  if(!targetFile.open(filename, create, parallel.worker)) {
     print(stderr, "warning: unable to open target file: ", filename, "\n");
+    parallel.unsupported = true;
     return false;
   }
 
-  tracker.addresses.clear();
+  parallel.targetName = filename;
+  parallel.targetRead = false;
+  parallel.written.clear();
+  tracker.ranges.clear();
   return true;
 }
 
@@ -26,72 +40,211 @@ bool Bass::source(const nall::string& filename) {
     return false;
   }
 
+  auto wall = Timing::Clock::now();
+  auto cpu = clock();
+  profile.depth++;
+
   unsigned fileNumber = sourceFilenames.size();
   sourceFilenames.append(filename);
 
-  nall::string data = nall::file::read(filename);
-  data.transform("\t\r", "  ");
-
-  auto lines = data.split("\n");
-  for(unsigned lineNumber : nall::range(lines.size())) {
-    //remove single-line comments
-    if(auto position = lines[lineNumber].qfind("//")) {
-      lines[lineNumber].resize(position());
-    }
-
-    //allow multiple statements per line, separated by ';'
-    auto blocks = lines[lineNumber].qsplit(";").strip();
-    for(unsigned blockNumber : nall::range(blocks.size())) {
-      nall::string statement = blocks[blockNumber];
-      strip(statement);
-      if(!statement) continue;
-
-      if(statement.match("include \"?*\"")) {
-        statement.trimLeft("include ", 1L).strip();
-        source({nall::Location::path(filename), text(statement)});
-      } else {
-        Instruction instruction;
-        instruction.statement = statement;
-        instruction.fileNumber = fileNumber;
-        instruction.lineNumber = 1 + lineNumber;
-        instruction.blockNumber = 1 + blockNumber;
-        program.append(instruction);
-      }
+  for(auto& statement : readSource(filename)) {
+    if(statement.include) {
+      auto name = statement.text;
+      name.trimLeft("include ", 1L).strip();
+      source({nall::Location::path(filename), text(name)});
+    } else {
+      Instruction instruction;
+      instruction.statement = statement.text;
+      instruction.fileNumber = fileNumber;
+      instruction.lineNumber = statement.lineNumber;
+      instruction.blockNumber = statement.blockNumber;
+      program.append(instruction);
     }
   }
 
+  if(!--profile.depth) profile.loading.add(wall, cpu);
+  if(tracing.enable) traceSpan(filename, "source", wall);
   return true;
 }
 
 void Bass::define(const nall::string& name, const nall::string& value) {
-  defines.insert({name, {}, value});
+  defines.insert({name, value});
 }
 
 void Bass::constant(const nall::string& name, const nall::string& value) {
   try {
-    constants.insert({name, evaluate(value, Evaluation::Strict)});
+    constants.insert({declare(name), evaluate(value, Evaluation::Strict)});
   } catch(...) {
   }
 }
 
+void Bass::cache(const nall::string& directory) {
+  cacheDirectory = directory;
+}
+
+void Bass::converge(bool enable) {
+  converging = enable;
+}
+
+void Bass::benchmark(bool enable) {
+  profile.enable = enable;
+}
+
+void Bass::annotate(bool enable) {
+  profile.annotate = enable;
+  if(enable) profile.enable = true;
+}
+
+void Bass::trace(const nall::string& filename) {
+  tracing.enable = (bool)filename;
+  tracing.filename = filename;
+  tracing.origin = Timing::Clock::now();
+}
+
+void Bass::jobs(unsigned count) {
+  parallel.jobs = count ? count : 1;
+}
+
+void Bass::incremental(const nall::string& directory) {
+  rebuild.directory = directory;
+}
+
 bool Bass::assemble(bool strict) {
   this->strict = strict;
 
   try {
     phase = Phase::Analyze;
+    auto wall = Timing::Clock::now();
+    auto cpu = clock();
     analyze();
+    profile.analyzing.add(wall, cpu);
+    if(tracing.enable) traceSpan("analyze", "pass", wall);
 
     phase = Phase::Query;
-    architecture = new Architecture{*this};
-    execute();
+    pass = 0;
+    query();
+
+    //each further pass starts from the values the previous one settled on.
+    //relaxing a branch moves everything after it, so that too repeats passes until labels settle
+    static const unsigned maximumPasses = 16;
+    auto repeat = [&] {
+      if(relaxed || (pass == 1 && unmeasured)) return true;
+      if(!converging && !relaxations) return false;
+      return changes || (pass == 1 && guesses);
+    };
+    while(repeat()) {
+      if(pass == maximumPasses) {
+        nall::print(stderr, nall::terminal::color::red("error: "), "constants did not converge after ", pass, " passes\n");
+        struct BassError {};
+        throw BassError();
+      }
+      query();
+      if(converging && changes) {
+        nall::string list;
+        for(unsigned n : nall::range(changes.size())) {
+          if(n == 8) { list.append(", ..."); break; }
+          list.append(n ? ", " : "", changes[n]);
+        }
+        nall::print(stderr, "bass: pass ", pass, ": ", changes.size(), " constant(s) changed: ", list, "\n");
+      }
+    }
+    if(converging) nall::print(stderr, "bass: converged after ", pass, " pass(es)\n");
 
+    //without forward references the query pass already computed every value; reuse its output
     phase = Phase::Write;
-    architecture = new Architecture{*this};
-    execute();
+    wall = Timing::Clock::now();
+    cpu = clock();
+    if(replayable) {
+      replay();
+    } else {
+      architecture = new Architecture{*this};
+      architectureName = "none";
+      startRegions();
+      execute();
+    }
+    targetFile.flush();
+    profile.writing.add(wall, cpu);
+    if(tracing.enable) traceSpan(replayable ? "write (replayed)" : "write", "pass", wall);
+    if(profile.enable && !profile.annotate) report();
+    if(profile.annotate) reportLines();
   } catch(...) {
+    if(parallel.worker) finishRegion(false);
+    targetFile.discard();
+    if(tracing.enable) writeTrace();
+    release();
     return false;
   }
 
+  if(tracing.enable) writeTrace();
+
+  saveRegions();
+  release();
+  return true;
+}
+
+//expression trees outlive the assembly, for the next one the process runs, until there are too many to keep
+void Bass::release() {
+  if(parses.size() > maximumParses) {
+    parses.reset();
+    arena.reset();
+  }
+  events.reset();
+  relaxations.reset();
+  releaseRegions();
+}
+
+void Bass::query() {
+  auto wall = Timing::Clock::now();
+  auto cpu = clock();
+  pass++;
+  abandonRegions();
+  architecture = new Architecture{*this};
+  architectureName = "none";
+  replayable = true;
+  guesses = 0;
+  relaxed = false;
+  unmeasured = false;
+  events.reset();
+  changes.reset();
+  execute();
+  profile.querying.add(wall, cpu);
+  if(tracing.enable) traceSpan({"query pass ", pass}, "pass", wall);
+}
+
+void Bass::replay() {
+  for(auto& event : events) {
+    switch(event.type) {
+    case Event::Type::Target: target(event.text, event.create); break;
+    case Event::Type::Seek: seek(event.offset); break;
+    case Event::Type::Print: print(stderr, event.text); break;
+    case Event::Type::Write:
+      if(targetFile) {
+        targetFile.write(event.data);
+      } else if(!isatty(fileno(stdout))) {
+        fwrite(event.data.data(), 1, event.data.size(), stdout);
+      }
+      break;
+    }
+  }
+}
+
+//whether this execution of a relaxable branch must take its long form.
+//a query pass relaxes any branch it measures out of range, for the rest of assembly;
+//a branch to a symbol that is not declared yet is left for a further query pass to measure
+bool Bass::relax(bool outOfRange, bool guessed) {
+  unsigned instruction = activeInstruction ? activeInstruction - program.data() : 0;
+  if(instruction >= visits.size()) visits.resize(instruction + 1);
+  Relaxation relaxation{instruction, visits[instruction]++};
+  if(rebuild.recording) recordRelaxation(instruction, relaxation.visit, (bool)relaxations.find(relaxation));
+  if(relaxations.find(relaxation)) return true;
+  if(!queryPhase()) return false;
+  if(guessed) {
+    unmeasured = true;
+    return false;
+  }
+  if(!outOfRange) return false;
+  relaxations.insert(relaxation);
+  relaxed = true;
   return true;
 }
 
@@ -104,17 +257,44 @@ unsigned Bass::pc() const {
 void Bass::seek(unsigned offset) {
   if(!targetFile) return;
   if(writePhase()) targetFile.seek(offset);
+  if(queryPhase() && replayable) {
+    Event event{Event::Type::Seek};
+    event.offset = offset;
+    events.append(event);
+  }
 }
 
+//a write that overlaps earlier ones is reported once, as the span of file offsets written again
 void Bass::track(unsigned length) {
-  if(!tracker.enable) return;
-  uint64_t address = targetFile.offset();
-  for(auto n : nall::range(length)) {
-    auto search_address = tracker.addresses.find(address + n);
-    if(search_address == tracker.addresses.end()) {
-      error("overwrite detected at address 0x", nall::hex(address + n), " [0x", nall::hex(base + address + n), "]");
+  if(parallel.worker && length) recordWrite(targetFile.offset(), length);
+  if(!tracker.enable || !length) return;
+  uint64_t start = targetFile.offset();
+  uint64_t end = start + length;
+  auto& ranges = tracker.ranges;
+
+  //first range that could overlap or adjoin [start, end)
+  auto range = ranges.upper_bound(start);
+  if(range != ranges.begin() && std::prev(range)->second >= start) range--;
+
+  uint64_t first = end, last = start;
+  uint64_t merged = start, mergedEnd = end;
+  while(range != ranges.end() && range->first <= end) {
+    if(range->first < end && range->second > start) {
+      first = std::min(first, std::max(start, range->first));
+      last = std::max(last, std::min(end, range->second));
+    }
+    merged = std::min(merged, range->first);
+    mergedEnd = std::max(mergedEnd, range->second);
+    range = ranges.erase(range);
+  }
+  ranges[merged] = mergedEnd;
+
+  if(first < last) {
+    if(last - first == 1) {
+      error("overwrite detected at address 0x", nall::hex(first), " [0x", nall::hex(base + first), "]");
     }
-    tracker.addresses.insert(address + n);
+    error("overwrite detected at addresses 0x", nall::hex(first), "-0x", nall::hex(last - 1),
+      " [0x", nall::hex(base + first), "-0x", nall::hex(base + last - 1), "]");
   }
 }
 
@@ -125,9 +305,52 @@ void Bass::write(uint64_t data, unsigned length) {
       if(endian == Endian::LSB) targetFile.writel(data, length);
       if(endian == Endian::MSB) targetFile.writem(data, length);
     } else if(!isatty(fileno(stdout))) {
+      abandonRegions();  //output to stdout is never split between processes
       if(endian == Endian::LSB) for(unsigned n : nall::range(length)) fputc(data >> n * 8, stdout);
       if(endian == Endian::MSB) for(unsigned n : nall::reverse(nall::range(length))) fputc(data >> n * 8, stdout);
     }
+  } else if(queryPhase() && replayable) {
+    if(!events || events.right().type != Event::Type::Write) events.append({Event::Type::Write});
+    auto& bytes = events.right().data;
+    if(endian == Endian::LSB) for(unsigned n : nall::range(length)) bytes.append(data >> n * 8);
+    if(endian == Endian::MSB) for(unsigned n : nall::reverse(nall::range(length))) bytes.append(data >> n * 8);
+  }
+  origin += length;
+}
+
+//bytes are written as given, regardless of endian
+void Bass::write(nall::array_view<uint8_t> memory) {
+  if(writePhase()) {
+    if(targetFile) {
+      track(memory.size());
+      targetFile.write(memory);
+    } else if(!isatty(fileno(stdout))) {
+      abandonRegions();
+      fwrite(memory.data(), 1, memory.size(), stdout);
+    }
+  } else if(queryPhase() && replayable) {
+    if(!events || events.right().type != Event::Type::Write) events.append({Event::Type::Write});
+    auto& bytes = events.right().data;
+    unsigned offset = bytes.size();
+    bytes.resize(offset + memory.size());
+    memcpy(bytes.data() + offset, memory.data(), memory.size());
+  }
+  origin += memory.size();
+}
+
+void Bass::fill(uint8_t data, unsigned length) {
+  if(writePhase()) {
+    if(targetFile) {
+      track(length);
+      targetFile.fill(data, length);
+    } else if(!isatty(fileno(stdout))) {
+      abandonRegions();
+      for(unsigned n : nall::range(length)) fputc(data, stdout);
+    }
+  } else if(queryPhase() && replayable) {
+    if(!events || events.right().type != Event::Type::Write) events.append({Event::Type::Write});
+    auto& bytes = events.right().data;
+    bytes.resize(bytes.size() + length, data);
   }
   origin += length;
 }
@@ -139,13 +362,16 @@ void Bass::printInstruction() {
   }
 }
 
+//diagnostics raised during the query pass are repeated by the write pass, so they rule out replay
 template<typename... P> void Bass::notice(P&&... p) {
+  if(queryPhase()) replayable = false;
   nall::string s{std::forward<P>(p)...};
   print(stderr, nall::terminal::color::gray("notice: "), s, "\n");
   printInstruction();
 }
 
 template<typename... P> void Bass::warning(P&&... p) {
+  if(queryPhase()) replayable = false;
   nall::string s{std::forward<P>(p)...};
   print(stderr, nall::terminal::color::yellow("warning: "), s, "\n");
   if(!strict) {
@@ -1,5 +1,10 @@
 #pragma once
 
+#if defined(API_POSIX)
+  #include <signal.h>
+  #include <sys/wait.h>
+#endif
+
 struct Architecture;
 
 struct Bass {
@@ -7,12 +12,39 @@ struct Bass {
   bool source(const nall::string& filename);
   void define(const nall::string& name, const nall::string& value);
   void constant(const nall::string& name, const nall::string& value);
+  void cache(const nall::string& directory);
+  void converge(bool enable);
+  void benchmark(bool enable);
+  void annotate(bool enable);
+  void trace(const nall::string& filename);
+  void jobs(unsigned count);
+  void incremental(const nall::string& directory);
   bool assemble(bool strict = false);
 
   enum class Phase : unsigned { Analyze, Query, Write };
   enum class Endian : unsigned { LSB, MSB };
   enum class Evaluation : unsigned { Default = 0, Strict = 1 };  //strict mode disallows forward-declaration of constants
 
+  struct Directive {
+    //ordered by matching priority; see analyzeDirective()
+    enum class Type : unsigned {
+      Unknown,
+      Exit, Macro, Inline, DefineFunction, Define, Evaluate, ExpressionFunction, Variable, Array, ArrayAssign,
+      If, ElseIf, Else, EndIf, While, EndWhile, Invoke, EndMacro,
+      Block, Namespace, EndNamespace, Function, EndFunction,
+      Constant, Label, LastLabel, NextLabel, EndConstant,
+      Output, Architecture, Endian, Origin, Base, Enqueue, Dequeue,
+      Copy, Insert, Delete, Fill, Map,
+      Ds, Tracker, Print, Notice, Warning, Error,
+      Instruction,  //architecture instruction or expression
+    } type = Type::Unknown;
+
+    bool global = false;
+    bool parent = false;
+    nall::string statement;               //statement without frame specifier
+    nall::vector<nall::string> operands;  //pre-split fields; meaning depends on type
+  };
+
   struct Instruction {
     nall::string statement;
     unsigned ip;
@@ -20,18 +52,58 @@ struct Bass {
     unsigned fileNumber;
     unsigned lineNumber;
     unsigned blockNumber;
+
+    bool dynamic = false;                  //statement contains {defines}; must be classified on each execution
+    nall::vector<Directive> directives;    //candidate directives, tried in order until one accepts the statement
+  };
+
+  //an identifier qualified by the scope node that contains it; both fields are interned ids
+  struct Symbol {
+    unsigned scope = 0;
+    unsigned name = 0;
+
+    unsigned hash() const {
+      unsigned h = scope * 0x9e3779b1 ^ name;
+      h ^= h >> 16; h *= 0x85ebca6b; h ^= h >> 13;
+      return h;
+    }
+    bool operator==(const Symbol& source) const { return scope == source.scope && name == source.name; }
+  };
+
+  //interned identifier text
+  struct Name {
+    Name() {}
+    Name(const nall::string& text, unsigned id = 0) : text(text), id(id) {}
+
+    unsigned hash() const { return text.hash(); }
+    bool operator==(const Name& source) const { return text == source.text; }
+
+    nall::string text;
+    unsigned id;
+  };
+
+  //node in the tree of namespaces, keyed by its parent node and name
+  struct Scope {
+    Scope() {}
+    Scope(unsigned parent, unsigned name, unsigned id = 0) : parent(parent), name(name), id(id) {}
+
+    unsigned hash() const { return Symbol{parent, name}.hash(); }
+    bool operator==(const Scope& source) const { return parent == source.parent && name == source.name; }
+
+    unsigned parent;
+    unsigned name;
+    unsigned id;
   };
 
   struct Macro {
     Macro() {}
-    Macro(const nall::string& name) : name(name) {}
-    Macro(const nall::string& name, const nall::vector<nall::string>& parameters, unsigned ip, bool inlined) : name(name), parameters(parameters), ip(ip), inlined(inlined) {}
+    Macro(const Symbol& symbol) : symbol(symbol) {}
+    Macro(const Symbol& symbol, const nall::vector<nall::string>& parameters, unsigned ip, bool inlined) : symbol(symbol), parameters(parameters), ip(ip), inlined(inlined) {}
 
-    unsigned hash() const { return name.hash(); }
-    bool operator==(const Macro& source) const { return name == source.name; }
-    bool operator< (const Macro& source) const { return name <  source.name; }
+    unsigned hash() const { return symbol.hash(); }
+    bool operator==(const Macro& source) const { return symbol == source.symbol; }
 
-    nall::string name;
+    Symbol symbol;
     nall::vector<nall::string> parameters;
     unsigned ip;
     bool inlined;
@@ -39,41 +111,41 @@ struct Bass {
 
   struct Define {
     Define() {}
-    Define(const nall::string& name) : name(name) {}
-    Define(const nall::string& name, const nall::vector<nall::string>& parameters, const nall::string& value) : name(name), parameters(parameters), value(value) {}
+    Define(const Symbol& symbol) : symbol(symbol) {}
+    Define(const Symbol& symbol, const nall::vector<nall::string>& parameters, const nall::string& value) : symbol(symbol), parameters(parameters), value(value) {}
 
-    unsigned hash() const { return name.hash(); }
-    bool operator==(const Define& source) const { return name == source.name; }
-    bool operator< (const Define& source) const { return name <  source.name; }
+    unsigned hash() const { return symbol.hash(); }
+    bool operator==(const Define& source) const { return symbol == source.symbol; }
 
-    nall::string name;
+    Symbol symbol;
     nall::vector<nall::string> parameters;
     nall::string value;
+    nall::string expansion;   //value with defines expanded; valid while generation == Bass::defineGeneration
+    unsigned generation = 0;
   };
 
   struct Variable {
     Variable() {}
-    Variable(const nall::string& name) : name(name) {}
-    Variable(const nall::string& name, int64_t value) : name(name), value(value) {}
+    Variable(const Symbol& symbol) : symbol(symbol) {}
+    Variable(const Symbol& symbol, int64_t value) : symbol(symbol), value(value) {}
 
-    unsigned hash() const { return name.hash(); }
-    bool operator==(const Variable& source) const { return name == source.name; }
-    bool operator< (const Variable& source) const { return name <  source.name; }
+    unsigned hash() const { return symbol.hash(); }
+    bool operator==(const Variable& source) const { return symbol == source.symbol; }
 
-    nall::string name;
+    Symbol symbol;
     int64_t value;
+    unsigned pass = 0;  //constants: query pass that last assigned value; 0 for command-line constants
   };
 
   struct Array {
     Array() {}
-    Array(const nall::string& name) : name(name) {}
-    Array(const nall::string& name, nall::vector<int64_t> values) : name(name), values(values) {}
+    Array(const Symbol& symbol) : symbol(symbol) {}
+    Array(const Symbol& symbol, nall::vector<int64_t> values) : symbol(symbol), values(values) {}
 
-    unsigned hash() const { return name.hash(); }
-    bool operator==(const Array& source) const { return name == source.name; }
-    bool operator< (const Array& source) const { return name <  source.name; }
+    unsigned hash() const { return symbol.hash(); }
+    bool operator==(const Array& source) const { return symbol == source.symbol; }
 
-    nall::string name;
+    Symbol symbol;
     nall::vector<int64_t> values;
   };
 
@@ -88,11 +160,24 @@ struct Bass {
     unsigned ip;
     bool inlined;
 
-    nall::hashset<Macro> macros;
-    nall::hashset<Define> defines;
-    nall::hashset<Define> expressions;
-    nall::hashset<Variable> variables;
-    nall::hashset<Array> arrays;
+    //parameters land in the inline sets; the rest allocate nothing until first used
+    nall::flat_set<Macro> macros;
+    nall::inline_set<Define, 4> defines;
+    nall::flat_set<Define> expressions;
+    nall::inline_set<Variable, 4> variables;
+    nall::flat_set<Array> arrays;
+  };
+
+  struct Parse {
+    Parse() {}
+    Parse(const nall::string& expression) : expression(expression) {}
+    Parse(const nall::string& expression, nall::Eval::Node* node) : expression(expression), node(node) {}
+
+    unsigned hash() const { return expression.hash(); }
+    bool operator==(const Parse& source) const { return expression == source.expression; }
+
+    nall::string expression;
+    nall::Eval::Node* node = nullptr;  //owned by Bass::arena
   };
 
   struct Block {
@@ -100,9 +185,190 @@ struct Bass {
     nall::string type;
   };
 
+  //architecture tables compiled into the binary; see Makefile
+  struct Builtin {
+    const char* name;
+    const char* text;
+  };
+
+  //one statement of a source file, as split from its lines
+  struct Statement {
+    nall::string text;
+    unsigned lineNumber;
+    unsigned blockNumber;
+    bool include;
+  };
+
+  //source files, kept split into statements for the life of the process; see readSource()
+  struct SourceFile {
+    SourceFile() {}
+    SourceFile(const nall::string& key) : key(key) {}
+
+    unsigned hash() const { return key.hash(); }
+    bool operator==(const SourceFile& source) const { return key == source.key; }
+
+    nall::string key;  //device and inode of the file
+    nall::string data;
+    int64_t modified = 0;  //nanoseconds
+    uint64_t size = 0;
+    nall::vector<Statement> statements;
+  };
+
+  //output effect of the query pass; replayed in place of the write pass when the query pass was complete
+  struct Event {
+    enum class Type : unsigned { Target, Seek, Write, Print } type;
+    nall::string text;           //Target: filename; Print: message
+    bool create = false;         //Target
+    unsigned offset = 0;         //Seek
+    nall::vector<uint8_t> data;  //Write: bytes, already in target endianness
+  };
+
+  //a relaxable branch that must take its long form, identified by its instruction and how often that instruction had already assembled one in the pass
+  struct Relaxation {
+    unsigned instruction = 0;
+    unsigned visit = 0;
+
+    unsigned hash() const {
+      unsigned h = instruction * 0x9e3779b1 ^ visit;
+      h ^= h >> 16; h *= 0x85ebca6b; h ^= h >> 13;
+      return h;
+    }
+    bool operator==(const Relaxation& source) const { return instruction == source.instruction && visit == source.visit; }
+  };
+
+  //time spent in one part of assembly, for -benchmark
+  struct Timing {
+    using Clock = std::chrono::steady_clock;
+
+    void add(Clock::time_point start) {
+      count++;
+      wall += std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    void add(Clock::time_point start, clock_t cpuStart) {
+      add(start);
+      cpu += double(clock() - cpuStart) / CLOCKS_PER_SEC;
+    }
+
+    unsigned count = 0;
+    double wall = 0;  //seconds
+    double cpu = 0;   //seconds; only measured for phases
+  };
+
+  //a macro being executed, while profiling or tracing
+  struct Call {
+    nall::string name;
+    Timing::Clock::time_point start;
+  };
+
+  //see profile.cpp
+  struct Profile {
+    bool enable = false;
+    unsigned depth = 0;  //nesting of source() calls, so that included files are not counted twice
+    Timing loading, analyzing, querying, writing;
+    Timing directives[(unsigned)Directive::Type::Instruction + 1];  //by the directive that accepted each statement
+    std::map<nall::string, Timing> architectures;  //statements assembled by each architecture
+    bool annotate = false;                         //list every source line with its counts, for -profile
+    nall::vector<Timing> lines[2];                 //indexed by instruction, for the query and write passes
+    std::map<nall::string, Timing> macros;         //including the macros each one invokes
+  };
+
+  //chrome trace_event spans, for -trace; see profile.cpp
+  struct Trace {
+    struct Span {
+      nall::string name;
+      nall::string category;
+      unsigned track;  //0: passes, files and macros; 1: architectures, which need not nest with the rest
+      double start;    //microseconds since tracing began
+      double duration;
+    };
+
+    bool enable = false;
+    nall::string filename;
+    Timing::Clock::time_point origin;
+    nall::vector<Span> spans;
+    Timing::Clock::time_point architectureStart;  //of the span for architectureName
+  };
+
+  //the write pass of each output region run by a forked process, for -jobs; see parallel.cpp
+  struct Region {
+    int pid = 0;
+    int control = -1;  //write end of the pipe the worker waits on: a byte starts it, closing the pipe dismisses it
+    bool running = false;
+    uint64_t start = 0;  //state the worker was forked in, for -incremental
+  };
+
+  struct Parallel {
+    static constexpr unsigned maximumRegions = 64;  //a worker past the last one also writes the regions after it
+    enum Status : uint8_t { Succeeded, Failed, Unsupported };
+
+    unsigned jobs = 1;
+    nall::vector<Region> regions;  //forked at each output directive of the current query pass
+    nall::string directory;        //temporary files shared with the workers
+    bool changed = false;          //the write pass assigned a constant a value other than the final query pass did
+
+    //state of a worker
+    bool worker = false;
+    unsigned region = 0;           //index into regions of the parent
+    unsigned count = 0;            //regions forked in the final query pass
+    nall::file_buffer results;     //start state, files read, targets written, then status and end state
+    nall::string targetName;       //target being written, and whether it was to be created
+    bool targetCreated = false;
+    bool targetRead = false;       //the region read back the target
+    std::map<uint64_t, uint64_t> written;  //offsets of the target written to, as disjoint [start, end) ranges
+    bool unsupported = false;      //the region did something that only the serial write pass can reproduce
+
+    bool taken = false;                 //the write pass was taken from the workers
+    nall::vector<uint64_t> locations;   //of each instruction, by file and line; see location()
+    nall::vector<uint64_t> nameKeys;    //of each interned name and scope node, by their text; see symbolKey()
+    nall::vector<uint64_t> scopeKeys;
+  };
+
+  //a constant a region looked up, and what it found
+  struct Consumed {
+    nall::string name;
+    bool found;
+    int64_t value;
+  };
+
+  //a relaxable branch a region assembled, and whether it took its long form
+  struct Lookup {
+    uint64_t location;
+    unsigned visit;
+    bool relaxed;
+  };
+
+  //what the results of a region tell; see readResults()
+  struct Outcome {
+    bool complete = false;
+    uint8_t status = Parallel::Unsupported;
+    uint64_t start = 0;
+    uint64_t end = 0;
+    bool changed = false;
+    nall::vector<nall::string> reads;
+    nall::vector<nall::string> targets;
+    nall::vector<nall::string> sources;   //the rest is only recorded for -incremental
+    nall::vector<Consumed> constants;
+    nall::vector<Lookup> relaxations;
+  };
+
+  //the regions of the last assembly, kept for the next one to reuse; see incremental.cpp
+  struct Incremental {
+    nall::string directory;  //disabled when empty
+    std::map<nall::string, nall::string> architectures;  //text of every architecture read, by name
+    unsigned reused = 0;     //regions of the last assembly taken in place of their workers
+
+    //state of a worker
+    bool recording = false;
+    unsigned first = 0;            //instruction the region starts at
+    nall::vector<bool> sources;    //files the region executed statements of, by file number
+    std::map<uint64_t, Consumed> constants;  //by symbol key
+    nall::vector<Lookup> relaxations;
+  };
+
   struct Tracker {
     bool enable = false;
-    std::set<int64_t> addresses;
+    std::map<uint64_t, uint64_t> ranges;  //written file offsets, as disjoint [start, end) ranges keyed by start
   };
 
   struct Directives {
@@ -130,10 +396,15 @@ protected:
   bool writePhase() const { return phase == Phase::Write; }
 
   //core.cpp
+  void release();
+  void query();
+  void replay();
   unsigned pc() const;
   void seek(unsigned offset);
   void track(unsigned length);
   void write(uint64_t data, unsigned length = 1);
+  void write(nall::array_view<uint8_t> memory);
+  void fill(uint8_t data, unsigned length);
 
   void printInstruction();
   void printInstructionStack();
@@ -155,14 +426,17 @@ protected:
   //analyze.cpp
   bool analyze();
   bool analyzeInstruction(Instruction& instruction);
+  nall::vector<Directive> analyzeDirectives(const nall::string& statement);
+  Directive analyzeDirective(const nall::string& statement, Directive::Type after);
 
   //execute.cpp
   bool execute();
   bool executeInstruction(Instruction& instruction);
+  bool executeDirective(const Directive& directive);
 
   //assemble.cpp
   void initialize();
-  bool assemble(const nall::string& statement);
+  bool assemble(const Directive& directive);
   nall::string assembleString(const nall::string& parameters);
 
   //utility.cpp
@@ -184,32 +458,96 @@ protected:
   void setArray(const nall::string& name, const nall::vector<int64_t>& values, Frame::Level level);
   nall::maybe<Bass::Array&> findArray(const nall::string& name);
 
+  nall::maybe<unsigned> internName(const nall::string& text, bool create);
+  nall::maybe<unsigned> internScope(unsigned parent, unsigned name, bool create);
+  nall::maybe<Symbol> resolve(unsigned node, const nall::string& name, bool create);
+  Symbol declare(const nall::string& name);
+  bool lookup(const nall::string& name);
+  nall::string symbolName(const Symbol& symbol);
+  unsigned currentScope() const;
+  void enterScope(const nall::string& name);
+  void leaveScope();
+
+  void leaveFrame();
   void evaluateDefines(nall::string& statement);
+  bool expandDefine(const nall::string& reference, nall::string& value);
 
   nall::string readArchitecture(const nall::string& s);
+  static nall::vector<Statement> readSource(const nall::string& filename);
+  void profileInstruction(Instruction& i, Timing::Clock::time_point start);
+  void report();
+  void reportLines();
+  void traceSpan(const nall::string& name, const char* category, Timing::Clock::time_point start, unsigned track = 0);
+  void traceArchitecture();
+  void writeTrace();
+  void startMeasuring();
+  void saveMeasurements(const nall::string& filename);
+  void addMeasurements(const nall::string& filename);
+  nall::vector<uint8_t> readFile(const nall::string& filename, unsigned offset, unsigned length);
+  bool relax(bool outOfRange, bool guessed);
+
+  //parallel.cpp
+  uint64_t location(unsigned ip);
+  uint64_t scopeKey(unsigned node);
+  uint64_t symbolKey(const Symbol& symbol);
+  uint64_t fingerprint();
+  void forkRegion();
+  void startRegion(Region& region);
+  void startRegions();
+  bool regionBoundary();
+  bool joinRegions();
+  void saveTarget();
+  [[noreturn]] void finishRegion(bool succeeded);
+  void abandonRegions();
+  void releaseRegions();
+  void recordRead(const nall::string& filename);
+  void recordTargetRead();
+  void recordWrite(uint64_t offset, uint64_t length);
+  Outcome readResults(const nall::string& filename, bool apply);
+
+  //incremental.cpp
+  uint64_t environment();
+  bool reusable(unsigned region, const Outcome& outcome,
+    const std::map<nall::string, uint64_t>& digests, const std::map<nall::string, int64_t>& values);
+  void reuseRegions();
+  void recordConstant(const Symbol& symbol, nall::maybe<Variable&> constant);
+  void recordRelaxation(unsigned instruction, unsigned visit, bool relaxed);
+  void saveRegions();
 
   nall::string filepath();
   nall::vector<nall::string> split(const nall::string& s);
-  void strip(nall::string& s);
+  static void strip(nall::string& s);
   bool validate(const nall::string& s);
   nall::string text(nall::string s);
   int64_t character(const nall::string& s);
 
   //internal state
   Instruction* activeInstruction = nullptr;  //used by notice, warning, error
+  Directive::Type executed = Directive::Type::Unknown;  //directive that last accepted a statement
   nall::vector<Instruction> program;    //parsed source code statements
   nall::vector<Block> blocks;           //track the start and end of blocks
-  std::set<Define> defines;             //defines specified on the terminal
-  nall::hashset<Variable> constants;    //constants support forward-declaration
+  std::map<nall::string, nall::string> defines;  //defines specified on the terminal
+  nall::flat_set<Variable> constants;   //constants support forward-declaration
+  nall::flat_set<Name> names;           //interned identifiers
+  nall::vector<nall::string> nameTable; //identifier text, indexed by name id
+  nall::flat_set<Scope> scopes;         //interned scope nodes
+  nall::vector<Scope> scopeTable;       //scope nodes, indexed by node id; node 0 is the global scope
+  nall::vector<Symbol> candidates;      //symbols considered by the last lookup(), innermost scope first
+  static constexpr unsigned maximumParses = 65536;
+  static nall::hashset<Parse> parses;   //expression trees, reused across passes, loop iterations and assemblies
+  static nall::Eval::Arena arena;       //storage for parsed expression trees
   nall::vector<Frame> frames;           //macros, defines and variables do not
   nall::vector<bool> conditionals;      //track conditional matching
   nall::vector<nall::string> queue;            //track enqueue, dequeue directives
-  nall::vector<nall::string> scope;            //track scope recursion
+  nall::vector<unsigned> scope;         //track scope recursion, as a stack of scope nodes
   int64_t stringTable[256];       //overrides for d[bwldq] text strings
   Phase phase;                    //phase of assembly
   Endian endian = Endian::LSB;    //used for multi-byte writes (d[bwldq], etc)
   Tracker tracker;                //used to track writes to detect overwrites
+  nall::vector<Event> events;     //output of the query pass
+  bool replayable = false;        //query pass referenced nothing undeclared, and its output is fully described by events
   unsigned macroInvocationCounter;    //used for {#} support
+  unsigned defineGeneration = 1;      //advanced whenever the defines visible to evaluateDefines() may change
   unsigned ip = 0;                    //instruction pointer into program
   unsigned origin = 0;                //file offset
   int base = 0;                   //file offset to memory map displacement
@@ -217,9 +555,25 @@ protected:
   unsigned nextLabelCounter = 1;      //+ instance counter
   bool charactersUseMap = false;  //0 = '*' parses as ASCII; 1 = '*' uses stringTable[]
   bool strict = false;            //upgrade warnings to errors when true
+  bool converging = false;        //repeat query passes until every constant keeps its value
+  unsigned pass = 0;              //number of the current query pass
+  unsigned guesses = 0;           //times the current query pass substituted pc() for an undeclared symbol
+  nall::flat_set<Relaxation> relaxations;  //branches that take their long form; only ever grows during assembly
+  nall::vector<unsigned> visits;  //relaxable branches assembled by each instruction in the current pass
+  bool relaxed = false;           //current query pass relaxed a branch
+  bool unmeasured = false;        //current query pass could not measure a relaxable branch to an undeclared symbol
+  nall::vector<nall::string> changes;  //constants whose value differed from the previous query pass
   Directives directives;          //active directives
 
-  nall::file_buffer targetFile;
+  nall::string cacheDirectory;    //where parsed architecture tables are stored; disabled when empty
+  nall::string architectureName = "none";  //last selected with the arch directive
+  Profile profile;
+  Trace tracing;
+  nall::vector<Call> calls;       //macros being executed, while profiling or tracing
+  Parallel parallel;
+  Incremental rebuild;
+
+  Image targetFile;               //assembled in memory; written back when closed, and when assembly succeeds
   nall::vector<nall::string> sourceFilenames;
 
   nall::shared_pointer<Architecture> architecture;
@@ -1,3 +1,6 @@
+nall::hashset<Bass::Parse> Bass::parses;
+nall::Eval::Arena Bass::arena;
+
 int64_t Bass::evaluate(const nall::string& expression, Evaluation mode) {
   nall::maybe<nall::string> name;
   if(expression == "--") name = {"lastLabel#", lastLabelCounter - 2};
@@ -6,18 +9,21 @@ int64_t Bass::evaluate(const nall::string& expression, Evaluation mode) {
   if(expression == "++") name = {"nextLabel#", nextLabelCounter + 1};
   if(name) {
     if(auto constant = findConstant({name()})) return constant().value;
-    if(queryPhase()) return pc();
+    if(queryPhase()) return replayable = false, guesses++, pc();
     error("relative label not declared");
   }
 
+  if(auto parse = parses.find({expression})) return evaluate(parse->node, mode);
+
   nall::Eval::Node* node = nullptr;
   try {
-    node = nall::Eval::parse(expression);
+    node = nall::Eval::parse(expression, arena);
   } catch(const char* reason) {
     error("malformed expression: ", expression, " [", reason, "]");
   } catch(...) {
     error("malformed expression: ", expression);
   }
+  parses.insert({expression, node});
   return evaluate(node, mode);
 }
 
@@ -102,20 +108,26 @@ int64_t Bass::evaluateExpression(nall::Eval::Node* node, Evaluation mode) {
     return 0;
   }
   if(name == "file.size#1") {
+    if(queryPhase()) replayable = false;  //the file may be one an earlier output wrote
     nall::string filename = evaluateString(node->link[1]).trim("\"", "\"", 1L);
     nall::string location = {filepath(), filename};
+    recordRead(location);
     if(nall::file::exists(location)) return nall::file::size(location);
     error("file not found: ", filename);
     return 0;
   }
   if(name == "file.exists#1") {
+    if(queryPhase()) replayable = false;
     nall::string filename = evaluateString(node->link[1]).trim("\"", "\"", 1L);
     nall::string location = {filepath(), filename};
+    recordRead(location);
     return nall::file::exists(location);
   }
   if(name == "read#1") {
     if(!targetFile) error("no target file open for reading");
+    if(queryPhase()) replayable = false;  //reads what earlier writes of the write pass produced
     int64_t address = evaluate(node->link[1], mode);
+    recordTargetRead();
     auto origin = targetFile.offset();
     targetFile.seek(address);
     uint8_t data = targetFile.read();
@@ -133,7 +145,7 @@ int64_t Bass::evaluateExpression(nall::Eval::Node* node, Evaluation mode) {
       setVariable(expression().parameters(n), evaluate(parameters.size()), Frame::Level::Inline);
     }
     auto result = evaluate(expression().value);
-    if(!parameters.empty()) frames.removeRight();
+    if(!parameters.empty()) leaveFrame();
     return result;
   }
 
@@ -168,7 +180,7 @@ int64_t Bass::evaluateLiteral(nall::Eval::Node* node, Evaluation mode) {
 
   if(auto variable = findVariable(s)) return variable().value;
   if(auto constant = findConstant(s)) return constant().value;
-  if(mode != Evaluation::Strict && queryPhase()) return pc();
+  if(mode != Evaluation::Strict && queryPhase()) return replayable = false, guesses++, pc();
 
   error("unrecognized variable: ", s);
   return 0;
@@ -192,9 +204,10 @@ int64_t Bass::evaluateSubscript(nall::Eval::Node* node, Evaluation mode) {
 int64_t Bass::evaluateAssign(nall::Eval::Node* node, Evaluation mode) {
   nall::string& s = node->link[0]->literal;
 
+  //evaluate first: expressions may push frames, moving any variable held inline by one
+  auto value = evaluate(node->link[1], mode);
   if(auto variable = findVariable(s)) {
-    variable().value = evaluate(node->link[1], mode);
-    return variable().value;
+    return variable().value = value;
   }
 
   error("unrecognized variable assignment: ", s);
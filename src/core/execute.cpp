@@ -1,186 +1,200 @@
 bool Bass::execute() {
   frames.reset();
+  defineGeneration++;
   conditionals.reset();
   ip = 0;
   macroInvocationCounter = 0;
+  visits.reset();
+  visits.resize(program.size());
 
   initialize();
 
   frames.append({0, false});
   for(auto& define : defines) {
-    setDefine(define.name, {}, define.value, Frame::Level::Inline);
+    setDefine(define.first, {}, define.second, Frame::Level::Inline);
+  }
+
+  calls.reset();
+  if(profile.enable) {
+    profile.lines[0].resize(program.size());
+    profile.lines[1].resize(program.size());
   }
 
   while(ip < program.size()) {
     Instruction& i = program(ip++);
+    auto start = profile.enable ? Timing::Clock::now() : Timing::Clock::time_point{};
+    if(rebuild.recording) rebuild.sources[i.fileNumber] = true;
     if(!executeInstruction(i)) error("unrecognized directive: ", i.statement);
+    //the statement that took the regions from their workers waited for them, and they measured themselves
+    if(profile.enable && !parallel.taken) profileInstruction(i, start);
   }
+  if(tracing.enable) traceArchitecture();
+  if(parallel.worker) finishRegion(true);
 
-  frames.removeRight();
+  leaveFrame();
   return true;
 }
 
 bool Bass::executeInstruction(Instruction& i) {
   activeInstruction = &i;
+
+  if(!i.dynamic) {
+    for(auto& directive : i.directives) {
+      executed = directive.type;
+      if(executeDirective(directive)) return true;
+    }
+    return false;
+  }
+
   nall::string s = i.statement;
   evaluateDefines(s);
+  for(auto& directive : analyzeDirectives(s)) {
+    executed = directive.type;
+    if(executeDirective(directive)) return true;
+  }
+  return false;
+}
 
-  bool global = s.beginsWith("global ");
-  bool parent = s.beginsWith("parent ");
-  if(global && parent) error("multiple frame specifiers are not allowed");
+bool Bass::executeDirective(const Directive& d) {
+  using Type = Directive::Type;
+  static const nall::string none;
+  auto o = [&](unsigned n) -> const nall::string& { return d.operands(n, none); };
+
+  if(d.global && d.parent) error("multiple frame specifiers are not allowed");
 
   Frame::Level level = Frame::Level::Active;
-  if(global) s.trimLeft("global ", 1L), level = Frame::Level::Global;
-  if(parent) s.trimLeft("parent ", 1L), level = Frame::Level::Parent;
+  if(d.global) level = Frame::Level::Global;
+  if(d.parent) level = Frame::Level::Parent;
 
-  if(s.equals("exit")) {
-    ip = program.size()+1;
-    return true;
-  }
+  switch(d.type) {
 
-  if(s.match("macro ?*(*) {")) {
-    bool inlined = false;
-    s.trim("macro ", ") {", 1L);
-    auto p = s.split("(", 1L).strip();
-    auto parameters = split(p(1));
-    setMacro(p(0), parameters, ip, inlined, level);
-    ip = i.ip;
+  case Type::Exit: {
+    ip = program.size()+1;
     return true;
   }
 
-  if(s.match("inline ?*(*) {")) {
-    bool inlined = true;
-    s.trim("inline ", ") {", 1L);
-    auto p = s.split("(", 1L).strip();
-    auto parameters = split(p(1));
-    setMacro(p(0), parameters, ip, inlined, level);
-    ip = i.ip;
+  case Type::Macro:
+  case Type::Inline: {
+    bool inlined = d.type == Type::Inline;
+    auto parameters = split(o(1));
+    setMacro(o(0), parameters, ip, inlined, level);
+    ip = activeInstruction->ip;
     return true;
   }
 
-  if(s.match("define ?*(*)*")) {
-    auto e = s.trimLeft("define ", 1L).split("=", 1L).strip();
-    auto p = e(0).trimRight(")", 1L).split("(", 1L).strip();
-    auto parameters = split(p(1));
-    setDefine(p(0), parameters, e(1), level);
+  case Type::DefineFunction: {
+    auto parameters = split(o(1));
+    setDefine(o(0), parameters, o(2), level);
     return true;
   }
 
-  if(s.match("define ?*")) {
-    auto p = s.trimLeft("define ", 1L).split("=", 1L).strip();
-    setDefine(p(0), {}, p(1), level);
+  case Type::Define: {
+    setDefine(o(0), {}, o(1), level);
     return true;
   }
 
-  if(s.match("evaluate ?*")) {
-    auto p = s.trimLeft("evaluate ", 1L).split("=", 1L).strip();
-    setDefine(p(0), {}, evaluate(p(1)), level);
+  case Type::Evaluate: {
+    setDefine(o(0), {}, evaluate(o(1)), level);
     return true;
   }
 
-  if(s.match("expression ?*(*)*")) {
-    auto e = s.trimLeft("expression ", 1L).split("=", 1L).strip();
-    auto p = e(0).trimRight(")", 1L).split("(", 1L).strip();
-    auto parameters = split(p(1));
-    setExpression(p(0), parameters, e(1), level);
+  case Type::ExpressionFunction: {
+    auto parameters = split(o(1));
+    setExpression(o(0), parameters, o(2), level);
     return true;
   }
 
-  if(s.match("variable ?*")) {
-    auto p = s.trimLeft("variable ", 1L).split("=", 1L).strip();
-    setVariable(p(0), evaluate(p(1)), level);
+  case Type::Variable: {
+    setVariable(o(0), evaluate(o(1)), level);
     return true;
   }
 
-  if(s.match("array[?*] ?*")) {
-    auto a = s.trimLeft("array[", 1L).split("]", 1L);
-    auto size = evaluate(a(0));
-    auto p = a(1).split("=", 1L).strip();
-    auto parameters = split(p(1));
+  case Type::Array: {
+    auto size = evaluate(o(0));
+    auto parameters = split(o(2));
     nall::vector<int64_t> values;
     for(auto& parameter : parameters) values.append(evaluate(parameter));
     if(values.size() > size) error("too many array elements: ", values.size(), " > ", size);
     values.resize(size);  //zero-initialize additional elements
-    setArray(p(0), values, level);
+    setArray(o(1), values, level);
     return true;
   }
 
   //evaluate() will evaluate array[index] to a value prior to evaluating =
   //as a result, array[index] assignment must be manually captured early
-  if(s.match("?*[?*] = ?*")) {
-    auto a = s.split("[", 1L).strip();
-    auto b = a(1).split("]", 1L).strip();
-    auto c = b(1).split("=", 1L).strip();
-    if(auto array = findArray(a(0))) {
-      auto index = evaluate(b(0));
+  case Type::ArrayAssign: {
+    if(auto array = findArray(o(0))) {
+      auto index = evaluate(o(1));
       if(index >= array->values.size()) error("array subscript out of bounds: ", index, " >= ", array->values.size());
-      auto value = evaluate(c(1));
+      auto value = evaluate(o(2));
       array->values[index] = value;
       return true;
     }
     //fallthrough: this may have matched another expression that wasn't an array[index] assignment
+    return false;
+  }
+
   }
 
-  if(global || parent) error("invalid frame specifier");
+  if(d.global || d.parent) error("invalid frame specifier");
 
-  if(s.match("if ?* {")) {
-    s.trim("if ", " {", 1L).strip();
-    bool match = evaluate(s, Evaluation::Strict);
+  switch(d.type) {
+
+  case Type::If: {
+    bool match = evaluate(o(0), Evaluation::Strict);
     conditionals.append(match);
     if(match == false) {
-      ip = i.ip;
+      ip = activeInstruction->ip;
     }
     return true;
   }
 
-  if(s.match("} else if ?* {")) {
+  case Type::ElseIf: {
     if(conditionals.right()) {
-      ip = i.ip;
+      ip = activeInstruction->ip;
     } else {
-      s.trim("} else if ", " {", 1L).strip();
-      bool match = evaluate(s, Evaluation::Strict);
+      bool match = evaluate(o(0), Evaluation::Strict);
       conditionals.right() = match;
       if(match == false) {
-        ip = i.ip;
+        ip = activeInstruction->ip;
       }
     }
     return true;
   }
 
-  if(s.match("} else {")) {
+  case Type::Else: {
     if(conditionals.right()) {
-      ip = i.ip;
+      ip = activeInstruction->ip;
     } else {
       conditionals.right() = true;
     }
     return true;
   }
 
-  if(s.match("} endif")) {
+  case Type::EndIf: {
     conditionals.removeRight();
     return true;
   }
 
-  if(s.match("while ?* {")) {
-    s.trim("while ", " {", 1L).strip();
-    bool match = evaluate(s, Evaluation::Strict);
-    if(match == false) ip = i.ip;
+  case Type::While: {
+    bool match = evaluate(o(0), Evaluation::Strict);
+    if(match == false) ip = activeInstruction->ip;
     return true;
   }
 
-  if(s.match("} endwhile")) {
-    ip = i.ip;
+  case Type::EndWhile: {
+    ip = activeInstruction->ip;
     return true;
   }
 
-  if(s.match("?*(*)")) {
-    auto p = nall::string{s}.trimRight(")", 1L).split("(", 1L).strip();
-    auto name = p(0);
-    auto parameters = split(p(1));
+  case Type::Invoke: {
+    nall::string name = o(0);
+    auto parameters = split(o(1));
     if(parameters) name.append("#", parameters.size());
     if(auto macro = findMacro({name})) {
+      if(profile.enable || tracing.enable) calls.append({name, Timing::Clock::now()});
       frames.append({ip, macro().inlined});
-      if(!frames.right().inlined) scope.append(p(0));
+      if(!frames.right().inlined) enterScope(o(0));
 
       setDefine("#", {}, {"_", macroInvocationCounter++, "_"}, Frame::Level::Inline);
       for(unsigned n : nall::range(parameters.size())) {
@@ -198,19 +212,22 @@ bool Bass::executeInstruction(Instruction& i) {
       ip = macro().ip;
       return true;
     }
+    return false;
   }
 
-  if(s.match("} endmacro") || s.match("} endinline")) {
+  case Type::EndMacro: {
+    if((profile.enable || tracing.enable) && calls) {
+      auto call = calls.takeRight();
+      if(profile.enable) profile.macros[call.name].add(call.start);
+      if(tracing.enable) traceSpan(call.name, "macro", call.start);
+    }
     ip = frames.right().ip;
-    if(!frames.right().inlined) scope.removeRight();
-    frames.removeRight();
+    if(!frames.right().inlined) leaveScope();
+    leaveFrame();
     return true;
   }
 
-  if(assemble(s)) {
-    return true;
   }
 
-  evaluate(s);
-  return true;
+  return assemble(d);
 }
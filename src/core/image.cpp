@@ -0,0 +1,207 @@
+bool Image::open(const nall::string& filename, bool create, bool detached) {
+  close();
+  stored = length = position = sought = 0;
+
+  //a detached image that is created starts out empty, and never touches the file
+  if(!detached || !create) {
+    #if defined(API_POSIX)
+    fileHandle = fopen(filename, detached ? "rb" : create ? "wb+" : "rb+");
+    #elif defined(API_WINDOWS)
+    fileHandle = _wfopen(nall::utf16_t(filename), detached ? L"rb" : create ? L"wb+" : L"rb+");
+    #endif
+    if(!fileHandle) return false;
+
+    fseek(fileHandle, 0, SEEK_END);
+    stored = length = ftell(fileHandle);
+  }
+  opened = true;
+  this->detached = detached;
+
+  #if defined(API_POSIX)
+  //a page that runs past the end of the file is left to the buffered path, so the mapping never grows
+  if(!create && !detached && stored >= PageSize) {
+    uint64_t size = stored & ~PageMask;
+    void* address = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileno(fileHandle), 0);
+    if(address != MAP_FAILED) {
+      mapping = (uint8_t*)address;
+      mappedPages = size >> PageBits;
+      touched.resize(mappedPages);
+    }
+  }
+  #endif
+  return true;
+}
+
+void Image::close() {
+  if(!opened) return;
+  flush();
+  if(fileHandle) fclose(fileHandle);
+  fileHandle = nullptr;
+  detach();
+}
+
+//closes the file without writing back what has not been flushed yet
+void Image::discard() {
+  if(fileHandle) fclose(fileHandle);
+  detach();
+}
+
+//forgets the file without writing anything back, as a forked process must with the file of its parent
+void Image::detach() {
+  #if defined(API_POSIX)
+  if(mapping) munmap(mapping, mappedPages << PageBits);
+  #endif
+  mapping = nullptr;
+  mappedPages = 0;
+  touched.reset();
+  fileHandle = nullptr;
+  opened = false;
+  detached = false;
+  pages.reset();
+  cachedIndex = ~0ull;
+  cachedData = nullptr;
+  cachedDirty = false;
+}
+
+void Image::flush() {
+  if(!opened || detached) return;
+
+  //the mapping is private, so that nothing reaches the file before it is flushed
+  for(uint64_t index = 0; index < mappedPages;) {
+    if(!touched[index]) { index++; continue; }
+    uint64_t first = index;
+    while(index < mappedPages && touched[index]) touched[index++] = false;
+    fseek(fileHandle, first << PageBits, SEEK_SET);
+    (void)fwrite(mapping + (first << PageBits), 1, (index - first) << PageBits, fileHandle);
+  }
+
+  nall::vector<uint64_t> dirty;
+  for(uint64_t index = mappedPages; index < (length + PageMask) >> PageBits; index++) {
+    if(auto page = pages.find({index})) {
+      if(page->dirty) dirty.append(index);
+    }
+  }
+
+  //runs of adjacent pages are written with a single seek
+  uint64_t next = ~0ull;
+  for(uint64_t index : dirty) {
+    auto& page = pages.find({index})();
+    uint64_t offset = index << PageBits;
+    if(offset != next) fseek(fileHandle, offset, SEEK_SET);
+    uint64_t size = std::min<uint64_t>(PageSize, length - offset);
+    (void)fwrite(page.data.data(), 1, size, fileHandle);
+    page.dirty = false;
+    next = offset + size;
+  }
+  cachedDirty = false;
+
+  //padding after the last written page
+  if(length > std::max<uint64_t>(stored, next == ~0ull ? 0 : next)) {
+    fflush(fileHandle);
+    #if defined(API_POSIX)
+    (void)ftruncate(fileno(fileHandle), length);
+    #elif defined(API_WINDOWS)
+    (void)_chsize(fileno(fileHandle), length);
+    #endif
+  }
+  fflush(fileHandle);
+  stored = length;
+}
+
+void Image::seek(uint64_t offset) {
+  if(!opened) return;
+  position = offset;
+  if(position > length) length = position;
+  if(position > sought) sought = position;
+}
+
+uint8_t Image::read() {
+  if(!opened || position >= length) return 0;
+  uint64_t index = position >> PageBits;
+  if(index != cachedIndex) cache(index, false);
+  return cachedData[position++ & PageMask];
+}
+
+void Image::read(nall::array_span<uint8_t> memory) {
+  uint8_t* data = memory.data();
+  uint64_t remaining = memory.size();
+  while(remaining && position < length) {
+    uint64_t index = position >> PageBits;
+    if(index != cachedIndex) cache(index, false);
+    uint64_t size = std::min<uint64_t>({remaining, PageSize - (position & PageMask), length - position});
+    memcpy(data, cachedData + (position & PageMask), size);
+    data += size;
+    remaining -= size;
+    position += size;
+  }
+  memset(data, 0, remaining);
+}
+
+void Image::write(nall::array_view<uint8_t> memory) {
+  const uint8_t* data = memory.data();
+  uint64_t remaining = memory.size();
+  while(remaining) {
+    uint64_t index = position >> PageBits;
+    if(index != cachedIndex || !cachedDirty) cache(index, true);
+    uint64_t size = std::min<uint64_t>(remaining, PageSize - (position & PageMask));
+    memcpy(cachedData + (position & PageMask), data, size);
+    data += size;
+    remaining -= size;
+    position += size;
+  }
+  if(position > length) length = position;
+}
+
+void Image::fill(uint8_t data, uint64_t length) {
+  uint64_t remaining = length;
+  while(remaining) {
+    uint64_t index = position >> PageBits;
+    if(index != cachedIndex || !cachedDirty) cache(index, true);
+    uint64_t size = std::min<uint64_t>(remaining, PageSize - (position & PageMask));
+    memset(cachedData + (position & PageMask), data, size);
+    remaining -= size;
+    position += size;
+  }
+  if(position > this->length) this->length = position;
+}
+
+void Image::writel(uint64_t data, unsigned length) {
+  while(length--) {
+    write(uint8_t(data));
+    data >>= 8;
+  }
+}
+
+void Image::writem(uint64_t data, unsigned length) {
+  for(unsigned n : nall::reverse(nall::range(length))) {
+    write(uint8_t(data >> n * 8));
+  }
+}
+
+//a page is read from the file the first time it is touched; bytes past the end of the file read as zero
+void Image::cache(uint64_t index, bool dirty) {
+  if(index < mappedPages) {
+    if(dirty) touched[index] = true;
+    cachedIndex = index;
+    cachedData = mapping + (index << PageBits);
+    cachedDirty = touched[index];
+    return;
+  }
+
+  auto page = pages.find({index});
+  if(!page) {
+    Page created;
+    created.index = index;
+    created.data.resize(PageSize);
+    uint64_t offset = index << PageBits;
+    if(fileHandle && offset < stored) {
+      fseek(fileHandle, offset, SEEK_SET);
+      (void)fread(created.data.data(), 1, std::min<uint64_t>(PageSize, stored - offset), fileHandle);
+    }
+    page = pages.insert(created);
+  }
+  if(dirty) page->dirty = true;
+  cachedIndex = index;
+  cachedData = page->data.data();
+  cachedDirty = page->dirty;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#if defined(API_POSIX)
+  #include <sys/mman.h>
+#endif
+
+//the target file, assembled in memory and written back when closed or flushed.
+//the image is split into pages that are read from the file when first touched;
+//only pages that were written to are written back, in ascending order.
+//when modifying an existing file, the pages it already holds are mapped privately rather than read,
+//and only those written to are written back.
+//a detached image only reads the file, and keeps what is written to it in memory.
+struct Image {
+  Image() = default;
+  Image(const Image&) = delete;
+  auto operator=(const Image&) -> Image& = delete;
+  ~Image() { close(); }
+
+  explicit operator bool() const { return opened; }
+
+  bool open(const nall::string& filename, bool create, bool detached = false);
+  void close();
+  void flush();
+  void discard();
+  void detach();
+
+  uint64_t offset() const { return position; }
+  uint64_t size() const { return length; }
+  uint64_t furthest() const { return sought; }
+  void seek(uint64_t offset);
+
+  uint8_t read();
+  void read(nall::array_span<uint8_t> memory);
+
+  void write(uint8_t data) {
+    uint64_t index = position >> PageBits;
+    if(index != cachedIndex || !cachedDirty) cache(index, true);
+    cachedData[position & PageMask] = data;
+    if(++position > length) length = position;
+  }
+  void write(nall::array_view<uint8_t> memory);
+  void fill(uint8_t data, uint64_t length);
+  void writel(uint64_t data, unsigned length);
+  void writem(uint64_t data, unsigned length);
+
+private:
+  static constexpr unsigned PageBits = 16;
+  static constexpr uint64_t PageSize = 1 << PageBits;
+  static constexpr uint64_t PageMask = PageSize - 1;
+
+  struct Page {
+    unsigned hash() const { return index * 0x9e3779b1 ^ index >> 32; }
+    bool operator==(const Page& source) const { return index == source.index; }
+
+    uint64_t index = 0;
+    bool dirty = false;
+    nall::vector<uint8_t> data;  //PageSize bytes; moving a page keeps its data in place
+  };
+
+  void cache(uint64_t index, bool dirty);
+
+  bool opened = false;
+  bool detached = false;
+  FILE* fileHandle = nullptr;       //may be null for a detached image
+  nall::flat_set<Page> pages;       //pages past the mapped part of the file
+  uint8_t* mapping = nullptr;       //whole pages of an existing file, mapped in modify mode
+  uint64_t mappedPages = 0;
+  nall::vector<bool> touched;       //mapped pages written to since the last flush
+  uint64_t stored = 0;    //size of the file on disk
+  uint64_t length = 0;    //size of the file once flushed; seeking past the end pads it
+  uint64_t position = 0;  //offset of the next read or write
+  uint64_t sought = 0;    //furthest offset sought to since opened
+
+  //the last page accessed; ~0 when none
+  uint64_t cachedIndex = ~0ull;
+  uint8_t* cachedData = nullptr;
+  bool cachedDirty = false;
+};
@@ -0,0 +1,184 @@
+//-incremental: the output regions of the last assembly are kept, so that the next one only writes the regions
+//that changed. regions are those of -jobs (see parallel.cpp), and a region is reused instead of written again
+//when it starts in the same state, every file it executed, read or wrote is as the last assembly left it, and
+//every constant and relaxable branch it looked up has kept its value. the query passes always run in full:
+//they are what settles the constants and the state each region starts in.
+//
+//directory layout: "record" lists the regions and the digest of every file they executed or read;
+//each region keeps its results and diagnostics as the worker that wrote it left them.
+
+static const nall::string RecordMagic = "bass-incremental";
+static const unsigned RecordVersion = 1;
+
+static uint64_t digestFile(const nall::string& filename) {
+  uint64_t hash = hashBasis;
+  auto fp = fopen(filename, "rb");
+  if(!fp) return 0;
+  uint8_t buffer[65536];
+  while(auto size = fread(buffer, 1, sizeof(buffer), fp)) {
+    for(unsigned n : nall::range(size)) hash = (hash ^ buffer[n]) * 0x100000001b3;
+  }
+  fclose(fp);
+  return hash;
+}
+
+//what every region depends on, besides what each one records
+uint64_t Bass::environment() {
+  uint64_t hash = hashBasis;
+  hashValue(hash, strict);
+  for(auto& define : defines) {
+    hashText(hash, define.first);
+    hashText(hash, define.second);
+  }
+  for(auto& architecture : rebuild.architectures) {
+    hashText(hash, architecture.first);
+    hashText(hash, architecture.second);
+  }
+  return hash;
+}
+
+//the worker of a reused region is dismissed, and the results of the last assembly take the place of its own
+void Bass::reuseRegions() {
+  #if defined(API_POSIX)
+  rebuild.reused = 0;
+  if(!rebuild.directory) return;
+  auto directory = rebuild.directory;
+  if(!directory.endsWith("/")) directory.append("/");
+
+  auto fp = nall::file::open({directory, "record"}, nall::file::mode::read);
+  if(!fp) return;
+  auto readString = [&]() -> nall::string {
+    unsigned length = fp.readl<unsigned>(4);
+    if(length > fp.size() - fp.offset()) return {};
+    return fp.reads(length);
+  };
+  if(fp.reads(RecordMagic.size()) != RecordMagic) return;
+  if(fp.readl<unsigned>(4) != RecordVersion) return;
+  if(fp.readl<uint64_t>(8) != environment()) return;
+  if(fp.readl<unsigned>(4) != parallel.regions.size()) return;
+  std::map<nall::string, uint64_t> digests;
+  for(unsigned count = fp.readl<unsigned>(4); count && !fp.end(); count--) {
+    auto name = readString();
+    uint64_t digest = fp.readl<uint64_t>(8);
+    if(digestFile(name) == digest) digests[name] = digest;
+  }
+  fp.close();
+
+  //a region writes only the bytes it recorded, so what a target held before does not matter to it;
+  //but what a region read from a file that any region writes depends on more than the file itself
+  nall::vector<Outcome> outcomes;
+  for(unsigned region : nall::range(parallel.regions.size())) {
+    outcomes.append(readResults({directory, region, ".results"}, false));
+    for(auto& filename : outcomes.right().targets) digests.erase(filename);
+  }
+
+  std::map<nall::string, int64_t> values;
+  constants.each([&](const Variable& constant) { values[symbolName(constant.symbol)] = constant.value; });
+
+  for(unsigned region : nall::range(parallel.regions.size())) {
+    if(!reusable(region, outcomes[region], digests, values)) continue;
+    if(!nall::file::copy({directory, region, ".results"}, {parallel.directory, region, ".results"})) continue;
+    if(!nall::file::copy({directory, region, ".log"}, {parallel.directory, region, ".log"})) continue;
+
+    auto& worker = parallel.regions[region];
+    close(worker.control);
+    worker.control = -1;
+    waitpid(worker.pid, nullptr, 0);
+    worker.pid = 0;
+    rebuild.reused++;
+  }
+  #endif
+}
+
+bool Bass::reusable(unsigned region, const Outcome& outcome,
+const std::map<nall::string, uint64_t>& digests, const std::map<nall::string, int64_t>& values) {
+  if(!outcome.complete || outcome.status != Parallel::Succeeded) return false;
+  if(outcome.start != parallel.regions[region].start) return false;
+
+  auto unchanged = [&](const nall::vector<nall::string>& filenames) {
+    for(auto& filename : filenames) {
+      if(digests.find(filename) == digests.end()) return false;
+    }
+    return true;
+  };
+  if(!unchanged(outcome.sources) || !unchanged(outcome.reads)) return false;
+
+  for(auto& constant : outcome.constants) {
+    auto value = values.find(constant.name);
+    if(constant.found != (value != values.end())) return false;
+    if(constant.found && value->second != constant.value) return false;
+  }
+
+  if(outcome.relaxations) {
+    std::map<uint64_t, unsigned> instructions;
+    for(unsigned n : nall::range(program.size())) instructions[location(n)] = n;
+    for(auto& lookup : outcome.relaxations) {
+      auto instruction = instructions.find(lookup.location);
+      if(instruction == instructions.end()) return false;
+      if(lookup.relaxed != (bool)relaxations.find({instruction->second, lookup.visit})) return false;
+    }
+  }
+  return true;
+}
+
+//constants are recorded by their full names, which mean the same to the next assembly, unlike their ids
+void Bass::recordConstant(const Symbol& symbol, nall::maybe<Variable&> constant) {
+  auto key = symbolKey(symbol);
+  if(rebuild.constants.count(key)) return;
+  rebuild.constants[key] = {symbolName(symbol), (bool)constant, constant ? constant().value : 0};
+}
+
+void Bass::recordRelaxation(unsigned instruction, unsigned visit, bool relaxed) {
+  rebuild.relaxations.append({location(instruction), visit, relaxed});
+}
+
+//called once assembly succeeds; an assembly whose write pass was not taken from the workers leaves nothing to reuse
+void Bass::saveRegions() {
+  #if defined(API_POSIX)
+  if(!rebuild.directory) return;
+  auto directory = rebuild.directory;
+  if(!directory.endsWith("/")) directory.append("/");
+  nall::inode::remove({directory, "record"});
+  if(!parallel.taken) return;
+  nall::print(stderr, "bass: ", rebuild.reused, " of ", parallel.count, " output region(s) reused\n");
+  if(!nall::directory::exists(directory) && mkdir(directory, 0755) < 0) {
+    nall::print(stderr, "warning: unable to create incremental directory: ", directory, "\n");
+    return;
+  }
+
+  std::map<nall::string, uint64_t> digests;
+  for(unsigned region : nall::range(Parallel::maximumRegions)) {
+    nall::string results{directory, region, ".results"};
+    nall::string log{directory, region, ".log"};
+    nall::inode::remove(results);
+    nall::inode::remove(log);
+    if(region >= parallel.count) continue;
+    if(!nall::file::copy({parallel.directory, region, ".results"}, results)) return;
+    if(!nall::file::copy({parallel.directory, region, ".log"}, log)) return;
+    auto outcome = readResults(results, false);
+    for(auto& filename : outcome.sources) digests[filename] = 0;
+    for(auto& filename : outcome.reads) digests[filename] = 0;
+  }
+  for(auto& entry : digests) entry.second = digestFile(entry.first);
+
+  nall::string temporary = {directory, "record.tmp"};
+  {
+    auto fp = nall::file::open(temporary, nall::file::mode::write);
+    if(!fp) return;
+    auto writeString = [&](const nall::string& s) {
+      fp.writel(s.size(), 4);
+      fp.writes(s);
+    };
+    fp.writes(RecordMagic);
+    fp.writel(RecordVersion, 4);
+    fp.writel(environment(), 8);
+    fp.writel(parallel.count, 4);
+    fp.writel(digests.size(), 4);
+    for(auto& entry : digests) {
+      writeString(entry.first);
+      fp.writel(entry.second, 8);
+    }
+  }
+  rename(temporary, nall::string{directory, "record"});
+  #endif
+}
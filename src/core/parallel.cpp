@@ -0,0 +1,577 @@
+//-jobs: the write pass of each output region runs in a process of its own.
+//a region runs from one output directive to the next. every query pass forks a worker at each output
+//directive, which waits there; once the final query pass has settled every constant, the workers are
+//started with the final constant table and write their region into memory, while bass itself writes
+//the part before the first output directive. processes rather than threads keep every string and table
+//private to one region, as nall::string's reference counts require.
+//
+//the regions are only taken over when they reproduce the serial write pass exactly:
+//each must start in the state the one before it ended in, none may read a file an earlier one wrote,
+//and none but the last may assign a constant a value other than the final query pass did.
+//otherwise the workers are dismissed, and bass carries on with the write pass by itself.
+
+static nall::string canonicalFilename(const nall::string& filename) {
+  char path[PATH_MAX] = "";
+  nall::string directory = nall::Location::path(filename);
+  if(!realpath(directory ? (const char*)directory : ".", path)) return filename;
+  return {path, "/", nall::Location::file(filename)};
+}
+
+static const uint64_t hashBasis = 0xcbf29ce484222325;
+
+static void hashValue(uint64_t& hash, uint64_t value) {
+  for(unsigned n : nall::range(8)) hash = (hash ^ uint8_t(value >> n * 8)) * 0x100000001b3;
+}
+
+static void hashText(uint64_t& hash, const nall::string& text) {
+  hashValue(hash, text.size());
+  for(char c : text) hash = (hash ^ uint8_t(c)) * 0x100000001b3;
+}
+
+//instructions are identified by file, inclusion of that file, line and statement, rather than by index,
+//so that an instruction keeps its identity when an edit adds or removes statements elsewhere
+uint64_t Bass::location(unsigned ip) {
+  auto& locations = parallel.locations;
+  if(locations.size() != program.size()) {
+    std::map<nall::string, unsigned> inclusions;
+    nall::vector<uint64_t> files;
+    for(auto& filename : sourceFilenames) {
+      uint64_t hash = hashBasis;
+      hashText(hash, filename);
+      hashValue(hash, inclusions[filename]++);
+      files.append(hash);
+    }
+    locations.reset();
+    for(auto& instruction : program) {
+      uint64_t hash = files[instruction.fileNumber];
+      hashValue(hash, instruction.lineNumber);
+      hashValue(hash, instruction.blockNumber);
+      locations.append(hash);
+    }
+  }
+  return ip < locations.size() ? locations[ip] : ~(uint64_t)(ip - locations.size());
+}
+
+//names and scopes are identified by their text rather than by their ids, which depend on the order they were interned in
+uint64_t Bass::scopeKey(unsigned node) {
+  auto& keys = parallel.scopeKeys;
+  while(keys.size() < scopeTable.size()) {
+    auto& scope = scopeTable[keys.size()];
+    uint64_t hash = hashBasis;
+    if(keys) {
+      hashValue(hash, keys[scope.parent]);
+      hashText(hash, nameTable[scope.name]);
+    }
+    keys.append(hash);
+  }
+  return node < keys.size() ? keys[node] : 0;
+}
+
+uint64_t Bass::symbolKey(const Symbol& symbol) {
+  auto& keys = parallel.nameKeys;
+  while(keys.size() < nameTable.size()) {
+    uint64_t hash = hashBasis;
+    hashText(hash, nameTable[keys.size()]);
+    keys.append(hash);
+  }
+  uint64_t hash = scopeKey(symbol.scope);
+  hashValue(hash, symbol.name < keys.size() ? keys[symbol.name] : 0);
+  return hash;
+}
+
+//everything the write pass carries from one region into the next, except constants, which are final
+uint64_t Bass::fingerprint() {
+  auto add = hashValue;
+  auto addString = hashText;
+  auto addSymbol = [&](uint64_t& hash, const Symbol& symbol) {
+    add(hash, symbolKey(symbol));
+  };
+
+  uint64_t hash = hashBasis;
+  for(auto& frame : frames) {
+    add(hash, location(frame.ip));
+    add(hash, frame.inlined);
+
+    //the sets are summed, so that the order they hold their values in does not matter
+    uint64_t sum = 0;
+    auto addDefine = [&](unsigned kind, const Define& define) {
+      uint64_t value = hashBasis;
+      add(value, kind);
+      addSymbol(value, define.symbol);
+      for(auto& parameter : define.parameters) addString(value, parameter);
+      addString(value, define.value);
+      sum += value;
+    };
+    frame.macros.each([&](const Macro& macro) {
+      uint64_t value = hashBasis;
+      addSymbol(value, macro.symbol);
+      for(auto& parameter : macro.parameters) addString(value, parameter);
+      add(value, location(macro.ip));
+      add(value, macro.inlined);
+      sum += value;
+    });
+    frame.defines.each([&](const Define& define) { addDefine(1, define); });
+    frame.expressions.each([&](const Define& define) { addDefine(2, define); });
+    frame.variables.each([&](const Variable& variable) {
+      uint64_t value = hashBasis;
+      addSymbol(value, variable.symbol);
+      add(value, variable.value);
+      sum += value;
+    });
+    frame.arrays.each([&](const Array& array) {
+      uint64_t value = hashBasis;
+      addSymbol(value, array.symbol);
+      for(auto element : array.values) add(value, element);
+      sum += value;
+    });
+    add(hash, sum);
+  }
+
+  add(hash, location(ip));
+  add(hash, activeInstruction ? location(activeInstruction - program.data()) : ~0);
+  for(bool conditional : conditionals) add(hash, conditional);
+  for(auto& entry : queue) addString(hash, entry);
+  for(unsigned node : scope) add(hash, scopeKey(node));
+  for(auto value : stringTable) add(hash, value);
+  add(hash, (unsigned)endian);
+  add(hash, origin);
+  add(hash, base);
+  add(hash, lastLabelCounter);
+  add(hash, nextLabelCounter);
+  add(hash, macroInvocationCounter);
+  add(hash, charactersUseMap);
+  add(hash, tracker.enable);
+  addString(hash, architectureName);
+  for(auto& directive : directives.EmitBytes) {
+    addString(hash, directive.token);
+    add(hash, directive.dataLength);
+  }
+  for(unsigned n : nall::range(visits.size())) {
+    if(!visits[n]) continue;
+    add(hash, location(n));
+    add(hash, visits[n]);
+  }
+  return hash;
+}
+
+//called by each output directive of a query pass; the worker forked here waits until the pass is known to be the last
+void Bass::forkRegion() {
+  #if defined(API_POSIX)
+  //while timing, regions are only forked for -incremental, and written one at a time
+  if(parallel.jobs < 2 && !rebuild.directory) return;
+  if((profile.enable || tracing.enable) && !rebuild.directory) return;
+  if(parallel.regions.size() >= Parallel::maximumRegions) return;
+
+  if(!parallel.directory) {
+    nall::string pattern{nall::Path::temporary(), "bass-XXXXXX"};
+    if(!mkdtemp(pattern.get())) {
+      parallel.jobs = 1;
+      return;
+    }
+    parallel.directory = {pattern, "/"};
+    signal(SIGPIPE, SIG_IGN);
+  }
+
+  int control[2];
+  if(pipe(control) < 0) return;
+  int pid = fork();
+  if(pid < 0) {
+    close(control[0]);
+    close(control[1]);
+    return;
+  }
+  if(pid) {
+    close(control[0]);
+    parallel.regions.append({pid, control[1], false, rebuild.directory ? fingerprint() : 0});
+    return;
+  }
+
+  //the worker keeps nothing of the regions forked before it
+  close(control[1]);
+  unsigned region = parallel.regions.size();
+  for(auto& sibling : parallel.regions) close(sibling.control);
+  parallel.regions.reset();
+
+  char start = 0;
+  if(read(control[0], &start, 1) != 1) _exit(EXIT_SUCCESS);
+  close(control[0]);
+
+  parallel.worker = true;
+  parallel.region = region;
+  parallel.changed = false;
+  parallel.unsupported = false;
+  int log = open(nall::string{parallel.directory, region, ".log"}, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+  if(log < 0 || dup2(log, STDERR_FILENO) < 0) _exit(EXIT_FAILURE);
+  close(log);
+  if(!parallel.results.open({parallel.directory, region, ".results"}, nall::file::mode::write)) _exit(EXIT_FAILURE);
+
+  //the final query pass interned every name this one had, under the same ids, and more
+  auto shared = nall::file::open({parallel.directory, "shared"}, nall::file::mode::read);
+  if(!shared) _exit(EXIT_FAILURE);
+  parallel.count = shared.readl<unsigned>(4);
+  names.reset();
+  nameTable.reset();
+  for(unsigned count = shared.readl<unsigned>(4), id = 0; id < count; id++) {
+    nall::string text = shared.reads(shared.readl<unsigned>(4));
+    names.insert({text, id});
+    nameTable.append(text);
+  }
+  scopes.reset();
+  scopeTable.reset();
+  for(unsigned count = shared.readl<unsigned>(4), id = 0; id < count; id++) {
+    unsigned parent = shared.readl<unsigned>(4);
+    unsigned name = shared.readl<unsigned>(4);
+    if(id) scopes.insert({parent, name, id});
+    scopeTable.append({parent, name, id});
+  }
+  constants.reset();
+  for(unsigned count = shared.readl<unsigned>(4); count; count--) {
+    Symbol symbol;
+    symbol.scope = shared.readl<unsigned>(4);
+    symbol.name = shared.readl<unsigned>(4);
+    constants.insert({symbol, (int64_t)shared.readl<uint64_t>(8)});
+  }
+
+  phase = Phase::Write;
+  targetFile.detach();
+  if(profile.enable || tracing.enable) startMeasuring();
+  parallel.results.writel(fingerprint(), 8);
+
+  rebuild.recording = (bool)rebuild.directory;
+  rebuild.first = activeInstruction ? activeInstruction - program.data() : 0;
+  rebuild.sources.reset();
+  rebuild.sources.resize(sourceFilenames.size());
+  rebuild.constants.clear();
+  rebuild.relaxations.reset();
+  #endif
+}
+
+//called as the write pass begins, once the constant table is final
+void Bass::startRegions() {
+  #if defined(API_POSIX)
+  if(!parallel.regions) return;
+  parallel.changed = false;
+  parallel.count = parallel.regions.size();
+
+  {
+    auto shared = nall::file::open({parallel.directory, "shared"}, nall::file::mode::write);
+    if(!shared) return abandonRegions();
+    auto writeString = [&](const nall::string& s) {
+      shared.writel(s.size(), 4);
+      shared.writes(s);
+    };
+    shared.writel(parallel.regions.size(), 4);
+    shared.writel(nameTable.size(), 4);
+    for(auto& text : nameTable) writeString(text);
+    shared.writel(scopeTable.size(), 4);
+    for(auto& node : scopeTable) {
+      shared.writel(node.parent, 4);
+      shared.writel(node.name, 4);
+    }
+    shared.writel(constants.size(), 4);
+    constants.each([&](const Variable& constant) {
+      shared.writel(constant.symbol.scope, 4);
+      shared.writel(constant.symbol.name, 4);
+      shared.writel(constant.value, 8);
+    });
+  }
+
+  reuseRegions();
+
+  //one job is bass itself, writing the part before the first output directive
+  unsigned jobs = profile.enable || tracing.enable ? 1 : parallel.jobs;
+  for(unsigned n : nall::range(std::min<unsigned>(jobs - 1, parallel.regions.size()))) {
+    startRegion(parallel.regions[n]);
+  }
+  #endif
+}
+
+void Bass::startRegion(Region& region) {
+  #if defined(API_POSIX)
+  if(region.control < 0) return;
+  region.running = ::write(region.control, "", 1) == 1;
+  close(region.control);
+  region.control = -1;
+  #endif
+}
+
+//an output directive of the write pass; true when the rest of the pass has been taken from the workers
+bool Bass::regionBoundary() {
+  if(parallel.worker) {
+    if(parallel.region + 1 < parallel.count) {
+      if(tracing.enable) traceArchitecture();
+      finishRegion(true);
+    }
+    return false;
+  }
+  if(!parallel.regions) return false;
+  return joinRegions();
+}
+
+bool Bass::joinRegions() {
+  #if defined(API_POSIX)
+  uint64_t state = fingerprint();
+  auto& regions = parallel.regions;
+
+  //start the rest as the first ones finish; one at a time while timing, so that the spans of workers do not overlap
+  unsigned jobs = profile.enable || tracing.enable ? 1 : parallel.jobs;
+  unsigned running = 0;
+  for(auto& region : regions) running += region.running;
+  for(unsigned next = 0; true;) {
+    while(running < jobs && next < regions.size()) {
+      auto& region = regions[next++];
+      if(region.control < 0) continue;
+      startRegion(region);
+      running += region.running;
+    }
+    if(!running) break;
+    int pid = waitpid(-1, nullptr, 0);
+    if(pid < 0) break;
+    for(auto& region : regions) {
+      if(region.pid != pid) continue;
+      region.pid = 0;
+      region.running = false;
+      running--;
+    }
+  }
+
+  auto results = [&](unsigned region, bool apply) {
+    return readResults({parallel.directory, region, ".results"}, apply);
+  };
+
+  //find how many regions reproduce the serial write pass, up to and including one that failed
+  nall::vector<nall::string> written;
+  if(targetFile) written.append(canonicalFilename(parallel.targetName));
+  unsigned taken = 0;
+  bool failed = false;
+  bool changed = parallel.changed;
+  for(unsigned region : nall::range(regions.size())) {
+    auto outcome = results(region, false);
+    if(!outcome.complete || outcome.start != state || changed) break;
+    bool reused = false;
+    for(auto& filename : outcome.reads) reused |= (bool)written.find(filename);
+    if(reused) break;
+    if(outcome.status == Parallel::Failed) {
+      taken = region + 1;
+      failed = true;
+      break;
+    }
+    if(outcome.status != Parallel::Succeeded) break;
+    for(auto& filename : outcome.targets) written.append(filename);
+    state = outcome.end;
+    changed = outcome.changed;
+    taken = region + 1;
+  }
+  if(taken < regions.size() && !failed) {
+    abandonRegions();
+    return false;
+  }
+
+  //a region that failed leaves the targets it had closed, but not the one it was writing
+  for(unsigned region : nall::range(taken)) {
+    auto log = nall::file::read({parallel.directory, region, ".log"});
+    if(log) fwrite(log.data(), 1, log.size(), stderr);
+    results(region, true);
+    if(profile.enable || tracing.enable) addMeasurements({parallel.directory, region, ".measurements"});
+  }
+  abandonRegions();
+  if(failed) {
+    targetFile.close();
+    struct BassError {};
+    throw BassError();
+  }
+  parallel.taken = true;
+  ip = program.size() + 1;
+  return true;
+  #else
+  return false;
+  #endif
+}
+
+//results are read once to check them, and again to write them out
+Bass::Outcome Bass::readResults(const nall::string& filename, bool apply) {
+  Outcome outcome;
+  auto fp = nall::file::open(filename, nall::file::mode::read);
+  if(!fp || fp.size() < 8) return outcome;
+  auto readString = [&]() -> nall::string {
+    unsigned length = fp.readl<unsigned>(4);
+    if(length > fp.size() - fp.offset()) return {};
+    return fp.reads(length);
+  };
+  outcome.start = fp.readl<uint64_t>(8);
+  while(!fp.end()) {
+    char type = fp.read();
+    if(type == 'R') {
+      outcome.reads.append(readString());
+    } else if(type == 'T') {
+      auto filename = readString();
+      bool create = fp.read();
+      uint64_t length = fp.readl<uint64_t>(8);
+      outcome.targets.append(canonicalFilename(filename));
+      if(apply) {
+        target(filename, create);
+        targetFile.seek(length);
+      }
+    } else if(type == 'P') {
+      uint64_t offset = fp.readl<uint64_t>(8);
+      unsigned size = fp.readl<unsigned>(4);
+      if(!apply) {
+        fp.seek(size, nall::file::index::relative);
+        continue;
+      }
+      nall::vector<uint8_t> data;
+      data.resize(size);
+      fp.read(data);
+      targetFile.seek(offset);
+      targetFile.write(data);
+    } else if(type == 'F') {
+      outcome.sources.append(readString());
+    } else if(type == 'C') {
+      Consumed constant;
+      constant.name = readString();
+      constant.found = fp.read();
+      constant.value = fp.readl<uint64_t>(8);
+      outcome.constants.append(constant);
+    } else if(type == 'X') {
+      Lookup lookup;
+      lookup.location = fp.readl<uint64_t>(8);
+      lookup.visit = fp.readl<unsigned>(4);
+      lookup.relaxed = fp.read();
+      outcome.relaxations.append(lookup);
+    } else if(type == 'E') {
+      outcome.status = fp.read();
+      outcome.end = fp.readl<uint64_t>(8);
+      outcome.changed = fp.read();
+      outcome.complete = true;
+      break;
+    } else {
+      break;
+    }
+  }
+  return outcome;
+}
+
+//a worker leaves each target it closes in its results, as the bytes written to it and how far it reached.
+//only those bytes are written back, so regions that share a target do not overwrite one another
+void Bass::saveTarget() {
+  auto& results = parallel.results;
+  uint64_t extent = targetFile.furthest();
+  if(!parallel.written.empty()) extent = std::max(extent, parallel.written.rbegin()->second);
+  results.write('T');
+  results.writel(parallel.targetName.size(), 4);
+  results.writes(parallel.targetName);
+  results.write(parallel.targetCreated);
+  results.writel(extent, 8);
+
+  nall::vector<uint8_t> data;
+  for(auto& range : parallel.written) {
+    for(uint64_t offset = range.first; offset < range.second; offset += data.size()) {
+      data.resize(std::min<uint64_t>(range.second - offset, 1 << 16));
+      targetFile.seek(offset);
+      targetFile.read(data);
+      results.write('P');
+      results.writel(offset, 8);
+      results.writel(data.size(), 4);
+      results.write(data);
+    }
+  }
+  parallel.written.clear();
+}
+
+//the region ends at the next output directive, or with the program
+void Bass::finishRegion(bool succeeded) {
+  if(succeeded && targetFile) saveTarget();
+  auto& results = parallel.results;
+  auto writeString = [&](const nall::string& s) {
+    results.writel(s.size(), 4);
+    results.writes(s);
+  };
+
+  //for -incremental: every file in the span of the region, or that it executed a statement of, then what it looked up
+  if(succeeded && rebuild.recording) {
+    for(unsigned n = rebuild.first; n < ip && n < program.size(); n++) rebuild.sources[program[n].fileNumber] = true;
+    nall::vector<nall::string> sources;
+    for(unsigned fileNumber : nall::range(rebuild.sources.size())) {
+      if(!rebuild.sources[fileNumber]) continue;
+      auto name = canonicalFilename(sourceFilenames[fileNumber]);
+      if(sources.find(name)) continue;
+      sources.append(name);
+      results.write('F');
+      writeString(name);
+    }
+    for(auto& entry : rebuild.constants) {
+      results.write('C');
+      writeString(entry.second.name);
+      results.write(entry.second.found);
+      results.writel(entry.second.value, 8);
+    }
+    for(auto& lookup : rebuild.relaxations) {
+      results.write('X');
+      results.writel(lookup.location, 8);
+      results.writel(lookup.visit, 4);
+      results.write(lookup.relaxed);
+    }
+  }
+
+  results.write('E');
+  results.write(!succeeded ? Parallel::Failed : parallel.unsupported ? Parallel::Unsupported : Parallel::Succeeded);
+  results.writel(succeeded ? fingerprint() : 0, 8);
+  results.write(parallel.changed);
+  results.close();
+  if(profile.enable || tracing.enable) saveMeasurements({parallel.directory, parallel.region, ".measurements"});
+  fflush(stderr);
+  _exit(EXIT_SUCCESS);
+}
+
+void Bass::abandonRegions() {
+  #if defined(API_POSIX)
+  for(auto& region : parallel.regions) {
+    if(region.running) kill(region.pid, SIGKILL);
+    if(region.control >= 0) close(region.control);
+    if(region.pid) waitpid(region.pid, nullptr, 0);
+  }
+  #endif
+  parallel.regions.reset();
+}
+
+void Bass::releaseRegions() {
+  abandonRegions();
+  if(!parallel.directory) return;
+  for(unsigned region : nall::range(Parallel::maximumRegions)) {
+    nall::inode::remove({parallel.directory, region, ".log"});
+    nall::inode::remove({parallel.directory, region, ".results"});
+    nall::inode::remove({parallel.directory, region, ".measurements"});
+  }
+  nall::inode::remove({parallel.directory, "shared"});
+  nall::inode::remove(parallel.directory);
+  parallel.directory = "";
+}
+
+//a worker cannot see what earlier regions write, so it names every file it reads
+void Bass::recordRead(const nall::string& filename) {
+  if(!parallel.worker) return;
+  auto name = canonicalFilename(filename);
+  parallel.results.write('R');
+  parallel.results.writel(name.size(), 4);
+  parallel.results.writes(name);
+}
+
+//the target holds what earlier regions wrote to it only once they are joined, so reading it back is a read of the file
+void Bass::recordTargetRead() {
+  if(!parallel.worker || parallel.targetRead) return;
+  parallel.targetRead = true;
+  recordRead(parallel.targetName);
+}
+
+void Bass::recordWrite(uint64_t offset, uint64_t length) {
+  auto& ranges = parallel.written;
+  uint64_t start = offset, end = offset + length;
+  auto range = ranges.upper_bound(start);
+  if(range != ranges.begin() && std::prev(range)->second >= start) range--;
+  while(range != ranges.end() && range->first <= end) {
+    start = std::min(start, range->first);
+    end = std::max(end, range->second);
+    range = ranges.erase(range);
+  }
+  ranges[start] = end;
+}
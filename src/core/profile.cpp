@@ -0,0 +1,285 @@
+//-benchmark: where assembly time went.
+//phases are timed always; statements, directives, architectures and macros only when profiling,
+//by wall time, summed over every pass that executed them.
+//-profile: every source line, with its execution count and self time in each pass.
+//-trace: the same phases, plus every source file and macro invocation, as a chrome trace_event file.
+
+//the statement's time is charged to its line and to the directive that accepted it
+void Bass::profileInstruction(Instruction& i, Timing::Clock::time_point start) {
+  profile.lines[writePhase()][&i - program.data()].add(start);
+  profile.directives[(unsigned)executed].add(start);
+}
+
+void Bass::report() {
+  static const char* directiveNames[] = {
+    "unknown",
+    "exit", "macro", "inline", "define function", "define", "evaluate", "expression", "variable", "array", "array assign",
+    "if", "elseif", "else", "endif", "while", "endwhile", "invoke", "endmacro",
+    "block", "namespace", "endnamespace", "function", "endfunction",
+    "constant", "label", "last label", "next label", "endconstant",
+    "output", "architecture", "endian", "origin", "base", "enqueue", "dequeue",
+    "copy", "insert", "delete", "fill", "map",
+    "ds", "tracker", "print", "notice", "warning", "error",
+    "instruction",
+  };
+  static const unsigned topCount = 10;
+
+  auto milliseconds = [](double seconds) -> nall::string {
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.3f", seconds * 1000.0);
+    return nall::pad(buffer, 11);
+  };
+  auto count = [](unsigned count) { return nall::pad(count, 10); };
+  auto column = [](const nall::string& text) { return nall::pad(text, -20); };
+
+  nall::print(stderr, "bass: profile\n");
+  nall::print(stderr, "  ", column("phase"), "      runs    wall ms     cpu ms\n");
+  auto phase = [&](const nall::string& name, const Timing& timing) {
+    nall::print(stderr, "  ", column(name), count(timing.count), milliseconds(timing.wall), milliseconds(timing.cpu), "\n");
+  };
+  phase("load", profile.loading);
+  phase("analyze", profile.analyzing);
+  phase("query", profile.querying);
+  phase(replayable ? "write (replayed)" : "write", profile.writing);
+
+  nall::print(stderr, "\n  ", column("directive"), "     count    wall ms\n");
+  std::vector<unsigned> order;
+  for(unsigned n : nall::range((unsigned)Directive::Type::Instruction + 1)) {
+    if(profile.directives[n].count) order.push_back(n);
+  }
+  std::sort(order.begin(), order.end(), [&](unsigned x, unsigned y) {
+    return profile.directives[x].wall > profile.directives[y].wall;
+  });
+  for(unsigned n : order) {
+    auto& timing = profile.directives[n];
+    nall::print(stderr, "  ", column(directiveNames[n]), count(timing.count), milliseconds(timing.wall), "\n");
+  }
+
+  //maps of names are listed slowest first
+  auto ranked = [&](const nall::string& title, const std::map<nall::string, Timing>& timings, unsigned limit) {
+    if(timings.empty()) return;
+    std::vector<const std::pair<const nall::string, Timing>*> entries;
+    for(auto& entry : timings) entries.push_back(&entry);
+    std::sort(entries.begin(), entries.end(), [](auto x, auto y) { return x->second.wall > y->second.wall; });
+    if(entries.size() > limit) entries.resize(limit);
+    nall::print(stderr, "\n  ", column(title), "     count    wall ms\n");
+    for(auto entry : entries) {
+      nall::print(stderr, "  ", column(entry->first), count(entry->second.count), milliseconds(entry->second.wall), "\n");
+    }
+  };
+  ranked("architecture", profile.architectures, ~0u);
+  ranked("macro", profile.macros, topCount);
+
+  nall::vector<Timing> lines;
+  for(unsigned n : nall::range(program.size())) {
+    Timing timing;
+    for(auto& pass : profile.lines) {
+      timing.count += pass[n].count;
+      timing.wall += pass[n].wall;
+    }
+    lines.append(timing);
+  }
+
+  order.clear();
+  for(unsigned n : nall::range(lines.size())) {
+    if(lines[n].count) order.push_back(n);
+  }
+  std::sort(order.begin(), order.end(), [&](unsigned x, unsigned y) {
+    return lines[x].wall > lines[y].wall;
+  });
+  if(order.size() > topCount) order.resize(topCount);
+  if(order.size()) nall::print(stderr, "\n  ", column("line"), "     count    wall ms\n");
+  for(unsigned n : order) {
+    auto& i = program[n];
+    auto& timing = lines[n];
+    nall::print(stderr, "  ", column({nall::Location::file(sourceFilenames[i.fileNumber]), ":", i.lineNumber}),
+      count(timing.count), milliseconds(timing.wall), "  ", i.statement, "\n");
+  }
+}
+
+//statements sharing a source line are reported together; lines that never ran are listed without counts
+void Bass::reportLines() {
+  auto milliseconds = [](double seconds) -> nall::string {
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.3f", seconds * 1000.0);
+    return nall::pad(buffer, 11);
+  };
+  auto sum = [](Timing& target, const Timing& source) {
+    target.count += source.count;
+    target.wall += source.wall;
+  };
+
+  for(unsigned fileNumber : nall::range(sourceFilenames.size())) {
+    auto source = nall::string::read(sourceFilenames[fileNumber]).split("\n");
+    nall::vector<Timing> query, write;
+    query.resize(source.size());
+    write.resize(source.size());
+    for(unsigned n : nall::range(program.size())) {
+      auto& i = program[n];
+      if(i.fileNumber != fileNumber || i.lineNumber > source.size()) continue;
+      sum(query[i.lineNumber - 1], profile.lines[0][n]);
+      sum(write[i.lineNumber - 1], profile.lines[1][n]);
+    }
+
+    nall::print(stderr, "bass: profile of ", sourceFilenames[fileNumber], "\n");
+    nall::print(stderr, " query hits   query ms", replayable ? "   (write pass replayed)" : " write hits   write ms", "\n");
+    for(unsigned n : nall::range(source.size())) {
+      auto line = source[n];
+      line.trimRight("\r", 1L);
+      if(n + 1 == source.size() && !line) break;
+      nall::string counts;
+      if(query[n].count) counts.append(nall::pad(query[n].count, 11), milliseconds(query[n].wall));
+      else counts.append(nall::pad("", 22));
+      if(write[n].count) counts.append(nall::pad(write[n].count, 11), milliseconds(write[n].wall));
+      else counts.append(nall::pad("", 22));
+      nall::print(stderr, counts, nall::pad(n + 1, 6), " | ", line, "\n");
+    }
+  }
+}
+
+void Bass::traceSpan(const nall::string& name, const char* category, Timing::Clock::time_point start, unsigned track) {
+  auto now = Timing::Clock::now();
+  Trace::Span span{name, category, track};
+  span.start = std::chrono::duration<double, std::micro>(start - tracing.origin).count();
+  span.duration = std::chrono::duration<double, std::micro>(now - start).count();
+  tracing.spans.append(span);
+}
+
+//closes the span of the architecture being left, and starts timing the one selected next
+void Bass::traceArchitecture() {
+  if(architectureName != "none") traceSpan(architectureName, "architecture", tracing.architectureStart, 1);
+  tracing.architectureStart = Timing::Clock::now();
+}
+
+void Bass::writeTrace() {
+  auto escape = [](const nall::string& text) {
+    nall::string result;
+    for(char c : text) {
+      if(c == '"' || c == '\\') result.append('\\', c);
+      else if((uint8_t)c < 0x20) result.append(' ');
+      else result.append(c);
+    }
+    return result;
+  };
+
+  //viewers draw complete ("X") events on the same track as nested when they are sorted by start
+  std::vector<const Trace::Span*> order;
+  for(auto& span : tracing.spans) order.push_back(&span);
+  std::stable_sort(order.begin(), order.end(), [](auto x, auto y) { return x->start < y->start; });
+
+  nall::string json = "{\"traceEvents\":[\n";
+  json.append("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"assembly\"}},\n");
+  json.append("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"architecture\"}}");
+  char times[64];
+  for(auto span : order) {
+    snprintf(times, sizeof(times), "\"ts\":%.3f,\"dur\":%.3f", span->start, span->duration);
+    json.append(",\n{\"name\":\"", escape(span->name), "\",\"cat\":\"", span->category,
+      "\",\"ph\":\"X\",", times, ",\"pid\":1,\"tid\":", span->track, "}");
+  }
+  json.append("\n]}\n");
+
+  if(!nall::file::write(tracing.filename, json)) {
+    nall::print(stderr, "warning: unable to write trace file: ", tracing.filename, "\n");
+  }
+  tracing.spans.reset();
+}
+
+//a worker writing a region for -incremental measures only its own part of the write pass,
+//which the parent adds to its own once the region is taken
+void Bass::startMeasuring() {
+  auto now = Timing::Clock::now();
+  for(auto& timing : profile.directives) timing = {};
+  for(auto& timing : profile.lines[1]) timing = {};
+  profile.architectures.clear();
+  profile.macros.clear();
+  for(auto& call : calls) call.start = now;
+  tracing.spans.reset();
+  tracing.architectureStart = now;
+}
+
+//times are kept in nanoseconds
+void Bass::saveMeasurements(const nall::string& filename) {
+  auto fp = nall::file::open(filename, nall::file::mode::write);
+  if(!fp) return;
+  auto writeString = [&](const nall::string& s) {
+    fp.writel(s.size(), 4);
+    fp.writes(s);
+  };
+  auto writeTiming = [&](char type, const Timing& timing) {
+    fp.write(type);
+    fp.writel(timing.count, 4);
+    fp.writel(uint64_t(timing.wall * 1e9), 8);
+  };
+
+  for(unsigned n : nall::range((unsigned)Directive::Type::Instruction + 1)) {
+    if(!profile.directives[n].count) continue;
+    writeTiming('D', profile.directives[n]);
+    fp.writel(n, 4);
+  }
+  for(unsigned n : nall::range(profile.lines[1].size())) {
+    if(!profile.lines[1][n].count) continue;
+    writeTiming('L', profile.lines[1][n]);
+    fp.writel(n, 4);
+  }
+  for(auto& entry : profile.architectures) {
+    writeTiming('A', entry.second);
+    writeString(entry.first);
+  }
+  for(auto& entry : profile.macros) {
+    writeTiming('M', entry.second);
+    writeString(entry.first);
+  }
+  for(auto& span : tracing.spans) {
+    fp.write('S');
+    fp.writel(span.track, 4);
+    fp.writel(uint64_t(span.start * 1e3), 8);
+    fp.writel(uint64_t(span.duration * 1e3), 8);
+    writeString(span.name);
+    writeString(span.category);
+  }
+}
+
+void Bass::addMeasurements(const nall::string& filename) {
+  auto fp = nall::file::open(filename, nall::file::mode::read);
+  if(!fp) return;
+  auto readString = [&]() -> nall::string {
+    unsigned length = fp.readl<unsigned>(4);
+    if(length > fp.size() - fp.offset()) return {};
+    return fp.reads(length);
+  };
+
+  while(!fp.end()) {
+    char type = fp.read();
+    if(type == 'S') {
+      Trace::Span span;
+      span.track = fp.readl<unsigned>(4);
+      span.start = fp.readl<uint64_t>(8) / 1e3;
+      span.duration = fp.readl<uint64_t>(8) / 1e3;
+      span.name = readString();
+      span.category = readString();
+      tracing.spans.append(span);
+      continue;
+    }
+
+    Timing timing;
+    timing.count = fp.readl<unsigned>(4);
+    timing.wall = fp.readl<uint64_t>(8) / 1e9;
+    auto add = [&](Timing& total) {
+      total.count += timing.count;
+      total.wall += timing.wall;
+    };
+    if(type == 'D') {
+      unsigned n = fp.readl<unsigned>(4);
+      if(n <= (unsigned)Directive::Type::Instruction) add(profile.directives[n]);
+    } else if(type == 'L') {
+      unsigned n = fp.readl<unsigned>(4);
+      if(n < profile.lines[1].size()) add(profile.lines[1][n]);
+    } else if(type == 'A') {
+      add(profile.architectures[readString()]);
+    } else if(type == 'M') {
+      add(profile.macros[readString()]);
+    } else {
+      break;
+    }
+  }
+}
@@ -1,7 +1,6 @@
 void Bass::setMacro(const nall::string& name, const nall::vector<nall::string>& parameters, unsigned ip, bool inlined, Frame::Level level) {
   if(!validate(name)) error("invalid macro identifier: ", name);
-  nall::string scopedName = {scope.merge("."), scope ? "." : "", name};
-  if(parameters) scopedName.append("#", parameters.size());
+  auto symbol = declare(parameters ? nall::string{name, "#", parameters.size()} : name);
 
   for(int n : reverse(nall::range(frames.size()))) {
     if(level != Frame::Level::Inline) {
@@ -11,12 +10,12 @@ void Bass::setMacro(const nall::string& name, const nall::vector<nall::string>&
     }
 
     auto& macros = frames[n].macros;
-    if(auto macro = macros.find({scopedName})) {
+    if(auto macro = macros.find({symbol})) {
       macro().parameters = parameters;
       macro().ip = ip;
       macro().inlined = inlined;
     } else {
-      macros.insert({scopedName, parameters, ip, inlined});
+      macros.insert({symbol, parameters, ip, inlined});
     }
 
     return;
@@ -24,16 +23,13 @@ void Bass::setMacro(const nall::string& name, const nall::vector<nall::string>&
 }
 
 nall::maybe<Bass::Macro&> Bass::findMacro(const nall::string& name) {
+  if(!lookup(name)) return nall::nothing;
   for(int n : nall::reverse(nall::range(frames.size()))) {
     auto& macros = frames[n].macros;
-    auto s = scope;
-    while(true) {
-      nall::string scopedName = {s.merge("."), s ? "." : "", name};
-      if(auto macro = macros.find({scopedName})) {
+    for(auto& symbol : candidates) {
+      if(auto macro = macros.find({symbol})) {
         return macro();
       }
-      if(!s) break;
-      s.removeRight();
     }
   }
 
@@ -42,8 +38,8 @@ nall::maybe<Bass::Macro&> Bass::findMacro(const nall::string& name) {
 
 void Bass::setDefine(const nall::string& name, const nall::vector<nall::string>& parameters, const nall::string& value, Frame::Level level) {
   if(!validate(name)) error("invalid define identifier: ", name);
-  nall::string scopedName = {scope.merge("."), scope ? "." : "", name};
-  if(parameters) scopedName.append("#", parameters.size());
+  auto symbol = declare(parameters ? nall::string{name, "#", parameters.size()} : name);
+  defineGeneration++;
 
   for(int n : nall::reverse(nall::range(frames.size()))) {
     if(level != Frame::Level::Inline) {
@@ -53,11 +49,11 @@ void Bass::setDefine(const nall::string& name, const nall::vector<nall::string>&
     }
 
     auto& defines = frames[n].defines;
-    if(auto define = defines.find({scopedName})) {
+    if(auto define = defines.find({symbol})) {
       define().parameters = parameters;
       define().value = value;
     } else {
-      defines.insert({scopedName, parameters, value});
+      defines.insert({symbol, parameters, value});
     }
 
     return;
@@ -65,16 +61,13 @@ void Bass::setDefine(const nall::string& name, const nall::vector<nall::string>&
 }
 
 nall::maybe<Bass::Define&> Bass::findDefine(const nall::string& name) {
+  if(!lookup(name)) return nall::nothing;
   for(int n : nall::reverse(nall::range(frames.size()))) {
     auto& defines = frames[n].defines;
-    auto s = scope;
-    while(true) {
-      nall::string scopedName = {s.merge("."), s ? "." : "", name};
-      if(auto define = defines.find({scopedName})) {
+    for(auto& symbol : candidates) {
+      if(auto define = defines.find({symbol})) {
         return define();
       }
-      if(!s) break;
-      s.removeRight();
     }
   }
 
@@ -83,8 +76,7 @@ nall::maybe<Bass::Define&> Bass::findDefine(const nall::string& name) {
 
 void Bass::setExpression(const nall::string& name, const nall::vector<nall::string>& parameters, const nall::string& value, Frame::Level level) {
   if(!validate(name)) error("invalid expression identifier: ", name);
-  nall::string scopedName = {scope.merge("."), scope ? "." : "", name};
-  if(parameters) scopedName.append("#", parameters.size());
+  auto symbol = declare(parameters ? nall::string{name, "#", parameters.size()} : name);
 
   for(int n : nall::reverse(nall::range(frames.size()))) {
     if(level != Frame::Level::Inline) {
@@ -94,11 +86,11 @@ void Bass::setExpression(const nall::string& name, const nall::vector<nall::stri
     }
 
     auto& expressions = frames[n].expressions;
-    if(auto expression = expressions.find({scopedName})) {
+    if(auto expression = expressions.find({symbol})) {
       expression().parameters = parameters;
       expression().value = value;
     } else {
-      expressions.insert({scopedName, parameters, value});
+      expressions.insert({symbol, parameters, value});
     }
 
     return;
@@ -106,16 +98,13 @@ void Bass::setExpression(const nall::string& name, const nall::vector<nall::stri
 }
 
 nall::maybe<Bass::Define&> Bass::findExpression(const nall::string& name) {
+  if(!lookup(name)) return nall::nothing;
   for(int n : nall::reverse(nall::range(frames.size()))) {
     auto& expressions = frames[n].expressions;
-    auto s = scope;
-    while(true) {
-      nall::string scopedName = {s.merge("."), s ? "." : "", name};
-      if(auto expression = expressions.find({scopedName})) {
+    for(auto& symbol : candidates) {
+      if(auto expression = expressions.find({symbol})) {
         return expression();
       }
-      if(!s) break;
-      s.removeRight();
     }
   }
 
@@ -124,7 +113,7 @@ nall::maybe<Bass::Define&> Bass::findExpression(const nall::string& name) {
 
 void Bass::setVariable(const nall::string& name, int64_t value, Frame::Level level) {
   if(!validate(name)) error("invalid variable identifier: ", name);
-  nall::string scopedName = {scope.merge("."), scope ? "." : "", name};
+  auto symbol = declare(name);
 
   for(int n : nall::reverse(nall::range(frames.size()))) {
     if(level != Frame::Level::Inline) {
@@ -134,10 +123,10 @@ void Bass::setVariable(const nall::string& name, int64_t value, Frame::Level lev
     }
 
     auto& variables = frames[n].variables;
-    if(auto variable = variables.find({scopedName})) {
+    if(auto variable = variables.find({symbol})) {
       variable().value = value;
     } else {
-      variables.insert({scopedName, value});
+      variables.insert({symbol, value});
     }
 
     return;
@@ -145,16 +134,13 @@ void Bass::setVariable(const nall::string& name, int64_t value, Frame::Level lev
 }
 
 nall::maybe<Bass::Variable&> Bass::findVariable(const nall::string& name) {
+  if(!lookup(name)) return nall::nothing;
   for(int n : nall::reverse(nall::range(frames.size()))) {
     auto& variables = frames[n].variables;
-    auto s = scope;
-    while(true) {
-      nall::string scopedName = {s.merge("."), s ? "." : "", name};
-      if(auto variable = variables.find({scopedName})) {
+    for(auto& symbol : candidates) {
+      if(auto variable = variables.find({symbol})) {
         return variable();
       }
-      if(!s) break;
-      s.removeRight();
     }
   }
 
@@ -163,25 +149,31 @@ nall::maybe<Bass::Variable&> Bass::findVariable(const nall::string& name) {
 
 void Bass::setConstant(const nall::string& name, int64_t value) {
   if(!validate(name)) error("invalid constant identifier: ", name);
-  nall::string scopedName = {scope.merge("."), scope ? "." : "", name};
-
-  if(auto constant = constants.find({scopedName})) {
-    if(queryPhase()) error("constant cannot be modified: ", scopedName);
+  auto symbol = declare(name);
+
+  //later query passes may reassign constants from earlier passes, but never within the same pass
+  if(auto constant = constants.find({symbol})) {
+    if(queryPhase() && (pass == 1 || constant().pass == pass)) error("constant cannot be modified: ", symbolName(symbol));
+    if(queryPhase()) {
+      if(constant().value != value) changes.append(symbolName(symbol));
+      constant().pass = pass;
+    }
+    if(writePhase() && constant().value != value) parallel.changed = true;
     constant().value = value;
   } else {
-    constants.insert({scopedName, value});
+    if(queryPhase() && pass > 1) changes.append(symbolName(symbol));
+    Variable declared{symbol, value};
+    declared.pass = queryPhase() ? pass : 0;
+    constants.insert(declared);
   }
 }
 
 nall::maybe<Bass::Variable&> Bass::findConstant(const nall::string& name) {
-  auto s = scope;
-  while(true) {
-    nall::string scopedName = {s.merge("."), s ? "." : "", name};
-    if(auto constant = constants.find({scopedName})) {
-      return constant();
-    }
-    if(!s) break;
-    s.removeRight();
+  if(!lookup(name)) return nall::nothing;
+  for(auto& symbol : candidates) {
+    auto constant = constants.find({symbol});
+    if(rebuild.recording) recordConstant(symbol, constant);
+    if(constant) return constant();
   }
 
   return nall::nothing;
@@ -189,7 +181,7 @@ nall::maybe<Bass::Variable&> Bass::findConstant(const nall::string& name) {
 
 void Bass::setArray(const nall::string& name, const nall::vector<int64_t>& values, Frame::Level level) {
   if(!validate(name)) error("invalid array identifier: ", name);
-  nall::string scopedName = {scope.merge("."), scope ? "." : "", name};
+  auto symbol = declare(name);
 
   for(int n : nall::reverse(nall::range(frames.size()))) {
     if(level != Frame::Level::Inline) {
@@ -199,10 +191,10 @@ void Bass::setArray(const nall::string& name, const nall::vector<int64_t>& value
     }
 
     auto& arrays = frames[n].arrays;
-    if(auto array = arrays.find({scopedName})) {
+    if(auto array = arrays.find({symbol})) {
       array().values = values;
     } else {
-      arrays.insert({scopedName, values});
+      arrays.insert({symbol, values});
     }
 
     return;
@@ -210,69 +202,269 @@ void Bass::setArray(const nall::string& name, const nall::vector<int64_t>& value
 }
 
 nall::maybe<Bass::Array&> Bass::findArray(const nall::string& name) {
+  if(!lookup(name)) return nall::nothing;
   for(int n : nall::reverse(nall::range(frames.size()))) {
     auto& arrays = frames[n].arrays;
-    auto s = scope;
-    while(true) {
-      nall::string scopedName = {s.merge("."), s ? "." : "", name};
-      if(auto array = arrays.find({scopedName})) {
+    for(auto& symbol : candidates) {
+      if(auto array = arrays.find({symbol})) {
         return array();
       }
-      if(!s) break;
-      s.removeRight();
     }
   }
 
   return nall::nothing;
 }
 
+//intern an identifier; when not creating, returns nothing for text that was never interned
+nall::maybe<unsigned> Bass::internName(const nall::string& text, bool create) {
+  if(auto name = names.find({text})) return name().id;
+  if(!create) return nall::nothing;
+  unsigned id = nameTable.size();
+  names.insert({text, id});
+  nameTable.append(text);
+  return id;
+}
+
+nall::maybe<unsigned> Bass::internScope(unsigned parent, unsigned name, bool create) {
+  if(!scopeTable) scopeTable.append({0, 0, 0});  //global scope
+  if(auto node = scopes.find({parent, name})) return node().id;
+  if(!create) return nall::nothing;
+  unsigned id = scopeTable.size();
+  scopes.insert({parent, name, id});
+  scopeTable.append({parent, name, id});
+  return id;
+}
+
+//walk the dotted components of name down from a scope node; the last component names the symbol
+nall::maybe<Bass::Symbol> Bass::resolve(unsigned node, const nall::string& name, bool create) {
+  unsigned offset = 0;
+  for(unsigned n : nall::range(name.size())) {
+    if(name[n] != '.') continue;
+    auto component = internName(slice(name, offset, n - offset), create);
+    if(!component) return nall::nothing;
+    auto child = internScope(node, component(), create);
+    if(!child) return nall::nothing;
+    node = child();
+    offset = n + 1;
+  }
+  auto leaf = internName(offset ? slice(name, offset) : name, create);
+  if(!leaf) return nall::nothing;
+  return Symbol{node, leaf()};
+}
+
+//the symbol a definition of name in the current scope creates
+Bass::Symbol Bass::declare(const nall::string& name) {
+  return resolve(currentScope(), name, true)();
+}
+
+//collect the symbols name may refer to, from the innermost enclosing scope outward
+//returns false when no symbol by that name can exist
+bool Bass::lookup(const nall::string& name) {
+  candidates.resize(0);
+  for(unsigned n : nall::reverse(nall::range(scope.size()))) {
+    if(auto symbol = resolve(scope[n], name, false)) candidates.append(symbol());
+  }
+  if(auto symbol = resolve(0, name, false)) candidates.append(symbol());
+  return (bool)candidates;
+}
+
+nall::string Bass::symbolName(const Symbol& symbol) {
+  nall::string result = nameTable[symbol.name];
+  for(unsigned node = symbol.scope; node; node = scopeTable[node].parent) {
+    result = {nameTable[scopeTable[node].name], ".", result};
+  }
+  return result;
+}
+
+unsigned Bass::currentScope() const {
+  return scope ? scope.right() : 0;
+}
+
+void Bass::enterScope(const nall::string& name) {
+  defineGeneration++;
+  auto symbol = declare(name);
+  scope.append(internScope(symbol.scope, symbol.name, true)());
+}
+
+void Bass::leaveScope() {
+  defineGeneration++;
+  scope.removeRight();
+}
+
+//expand {name} and {name(parameters)} references, innermost and rightmost first.
+//scans right to left once: after a substitution, the text to its right is unchanged,
+//so scanning resumes at the end of the substituted value rather than restarting.
 void Bass::evaluateDefines(nall::string& s) {
-  for(int x = s.size() - 1, y = -1; x >= 0; x--) {
-    if(s[x] == '}') y = x;
-    if(s[x] == '{' && y > x) {
-      nall::string name = slice(s, x + 1, y - x - 1);
-
-      if(name.match("defined ?*")) {
-        name.trimLeft("defined ", 1L).strip();
-        s = {slice(s, 0, x), findDefine(name) ? 1 : 0, slice(s, y + 1)};
-        return evaluateDefines(s);
-      }
+  if(!strchr(s.data(), '{')) return;
+
+  int y = -1;  //nearest '}' to the right of x
+  for(int x = s.size() - 1; x >= 0; x--) {
+    if(s[x] == '}') { y = x; continue; }
+    if(s[x] != '{' || y < x) continue;
+
+    nall::string value;
+    if(!expandDefine(slice(s, x + 1, y - x - 1), value)) continue;
+
+    //locate the '}' nearest to the end of the value before the text shifts
+    int next = y + 1;
+    while(next < (int)s.size() && s[next] != '}') next++;
+    next = next < (int)s.size() ? next - (y + 1) + x + (int)value.size() : -1;
+
+    //splice value over {reference}
+    unsigned length = y + 1 - x;
+    unsigned size = s.size();
+    if(value.size() > length) s.resize(size + value.size() - length);
+    auto p = s.get();
+    nall::memory::move(p + x + value.size(), p + x + length, size - x - length);
+    nall::memory::copy(p + x, value.data(), value.size());
+    if(value.size() < length) s.resize(size + value.size() - length);
+
+    y = next;
+    x += value.size();
+  }
+}
 
-      nall::vector<nall::string> parameters;
-      if(name.match("?*(*)")) {
-        auto p = name.trimRight(")", 1L).split("(", 1L).strip();
-        name = p(0);
-        parameters = split(p(1));
-      }
-      if(parameters) name.append("#", parameters.size());
-
-      if(auto define = findDefine(name)) {
-        if(parameters) frames.append({0, true});
-        for(auto n : nall::range(parameters.size())) {
-          auto p = define().parameters(n).split(" ", 1L).strip();
-          if(p.size() == 1) p.prepend("define");
-
-          if(0);
-          else if(p[0] == "define") setDefine(p[1], {}, parameters(n), Frame::Level::Inline);
-          else if(p[0] == "string") setDefine(p[1], {}, text(parameters(n)), Frame::Level::Inline);
-          else if(p[0] == "evaluate") setDefine(p[1], {}, evaluate(parameters(n)), Frame::Level::Inline);
-          else error("unsupported parameter type: ", p[0]);
-        }
-        auto value = define().value;
-        evaluateDefines(value);
-        s = {slice(s, 0, x), value, slice(s, y + 1)};
-        if(parameters) frames.removeRight();
-        return evaluateDefines(s);
-      }
+//resolve the contents of one {reference}; returns false when it does not name a define
+bool Bass::expandDefine(const nall::string& reference, nall::string& value) {
+  nall::string name = reference;
+
+  if(name.match("defined ?*")) {
+    name.trimLeft("defined ", 1L).strip();
+    value = findDefine(name) ? "1" : "0";
+    return true;
+  }
+
+  nall::vector<nall::string> parameters;
+  if(name.match("?*(*)")) {
+    auto p = name.trimRight(")", 1L).split("(", 1L).strip();
+    name = p(0);
+    parameters = split(p(1));
+  }
+  if(parameters) name.append("#", parameters.size());
+
+  auto define = findDefine(name);
+  if(!define) return false;
+
+  //parameterless expansions only depend on which defines are visible, so they are memoized
+  if(!parameters && define().generation == defineGeneration) {
+    value = define().expansion;
+    return true;
+  }
+
+  //define may be held inline by a frame, which pushing another frame can move
+  auto formals = define().parameters;
+  value = define().value;
+  unsigned generation = defineGeneration;
+
+  if(parameters) frames.append({0, true});
+  for(auto n : nall::range(parameters.size())) {
+    auto p = formals(n).split(" ", 1L).strip();
+    if(p.size() == 1) p.prepend("define");
+
+    if(0);
+    else if(p[0] == "define") setDefine(p[1], {}, parameters(n), Frame::Level::Inline);
+    else if(p[0] == "string") setDefine(p[1], {}, text(parameters(n)), Frame::Level::Inline);
+    else if(p[0] == "evaluate") setDefine(p[1], {}, evaluate(parameters(n)), Frame::Level::Inline);
+    else error("unsupported parameter type: ", p[0]);
+  }
+  evaluateDefines(value);
+  if(parameters) leaveFrame();
+
+  if(!parameters && generation == defineGeneration) {
+    if(auto define = findDefine(name)) {
+      define().expansion = value;
+      define().generation = generation;
     }
   }
+  return true;
+}
+
+//drop the innermost frame; any define it held may have been captured by a memoized expansion
+void Bass::leaveFrame() {
+  if(frames.right().defines) defineGeneration++;
+  frames.removeRight();
 }
 
+//reads a span of a file with a single read; stops short at the end of the file
+nall::vector<uint8_t> Bass::readFile(const nall::string& filename, unsigned offset, unsigned length) {
+  nall::vector<uint8_t> memory;
+  recordRead(filename);
+  auto fp = fopen(filename, "rb");
+  if(!fp) error("file not found: ", filename);
+  memory.resize(length);
+  fseek(fp, offset, SEEK_SET);
+  memory.resize(fread(memory.data(), 1, length, fp));
+  fclose(fp);
+  return memory;
+}
+
+//source files are split into statements once, and shared by every assembly the process runs:
+//each job of a batch, and each request a server answers. a file is read again once its size or
+//modification time changes, and only split again if its contents did.
+//files are known by device and inode rather than by name, which is relative to a working directory
+//that differs from one request to the next.
+nall::vector<Bass::Statement> Bass::readSource(const nall::string& filename) {
+  static nall::hashset<SourceFile> cache;
+  struct stat status;
+  if(stat(filename, &status) < 0) return {};
+  #if defined(API_POSIX)
+  nall::string key{(uint64_t)status.st_dev, ":", (uint64_t)status.st_ino};
+  #else
+  nall::string key = filename;
+  #endif
+  #if defined(PLATFORM_MACOS)
+  int64_t modified = status.st_mtimespec.tv_sec * 1'000'000'000ll + status.st_mtimespec.tv_nsec;
+  #elif defined(API_POSIX)
+  int64_t modified = status.st_mtim.tv_sec * 1'000'000'000ll + status.st_mtim.tv_nsec;
+  #else
+  int64_t modified = status.st_mtime * 1'000'000'000ll;
+  #endif
+
+  auto file = cache.find({key});
+  if(file && file->modified == modified && file->size == (uint64_t)status.st_size) return file->statements;
+  if(!file) file = cache.insert({key});
+  file->modified = modified;
+  file->size = status.st_size;
+  auto data = nall::string::read(filename);
+  if(data == file->data && file->statements) return file->statements;
+  file->data = data;
+  file->statements.reset();
+
+  data.transform("\t\r", "  ");
+  auto lines = data.split("\n");
+  for(unsigned lineNumber : nall::range(lines.size())) {
+    //remove single-line comments
+    if(auto position = lines[lineNumber].qfind("//")) {
+      lines[lineNumber].resize(position());
+    }
+
+    //allow multiple statements per line, separated by ';'
+    auto blocks = lines[lineNumber].qsplit(";").strip();
+    for(unsigned blockNumber : nall::range(blocks.size())) {
+      nall::string statement = blocks[blockNumber];
+      strip(statement);
+      if(!statement) continue;
+      bool include = statement.match("include \"?*\"");
+      file->statements.append({statement, 1 + lineNumber, 1 + blockNumber, include});
+    }
+  }
+  return file->statements;
+}
+
+//user architectures override the built-in tables, which override those installed next to the program
 nall::string Bass::readArchitecture(const nall::string& s) {
-  nall::string location{nall::Path::userData(), "bass/architectures/", s, ".arch"};
-  if(!nall::file::exists(location)) location = {nall::Path::program(), "architectures/", s, ".arch"};
-  if(!nall::file::exists(location)) error("unknown architecture: ", s);
-  return nall::string::read(location);
+  auto text = [&]() -> nall::string {
+    nall::string location{nall::Path::userData(), "bass/architectures/", s, ".arch"};
+    if(nall::file::exists(location)) return nall::string::read(location);
+    for(auto& builtin : BuiltinArchitectures) {
+      if(s == builtin.name) return builtin.text;
+    }
+    location = {nall::Path::program(), "architectures/", s, ".arch"};
+    if(!nall::file::exists(location)) error("unknown architecture: ", s);
+    return nall::string::read(location);
+  }();
+  if(rebuild.directory) rebuild.architectures[s] = text;
+  return text;
 }
 
 nall::string Bass::filepath() {
@@ -0,0 +1,243 @@
+#if defined(API_POSIX)
+static volatile sig_atomic_t serverStopping = 0;
+
+static bool socketAddress(const nall::string& socket, sockaddr_un& address) {
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if(!socket || socket.size() >= sizeof(address.sun_path)) return false;
+  memcpy(address.sun_path, socket.data(), socket.size());
+  return true;
+}
+
+static bool transfer(int descriptor, void* data, unsigned length, bool receive) {
+  auto bytes = (uint8_t*)data;
+  while(length) {
+    auto size = receive ? read(descriptor, bytes, length) : write(descriptor, bytes, length);
+    if(size < 0 && errno == EINTR) continue;
+    if(size <= 0) return false;
+    bytes += size;
+    length -= size;
+  }
+  return true;
+}
+#endif
+
+bool Server::listen(const nall::string& socket) {
+  #if defined(API_POSIX)
+  sockaddr_un address;
+  if(!socketAddress(socket, address)) {
+    nall::print(stderr, "error: socket name is too long: ", socket, "\n");
+    return false;
+  }
+
+  listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if(listener < 0) {
+    nall::print(stderr, "error: unable to create socket: ", strerror(errno), "\n");
+    return false;
+  }
+  int result = bind(listener, (sockaddr*)&address, sizeof(address));
+  if(result < 0 && errno == EADDRINUSE) {
+    //a socket left behind by a server that has gone away is replaced
+    int probe = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    bool listening = probe >= 0 && connect(probe, (sockaddr*)&address, sizeof(address)) == 0;
+    if(probe >= 0) close(probe);
+    if(listening) {
+      nall::print(stderr, "error: a server is already listening on ", socket, "\n");
+      close(listener);
+      return false;
+    }
+    unlink(socket);
+    result = bind(listener, (sockaddr*)&address, sizeof(address));
+  }
+  if(result < 0 || ::listen(listener, 16) < 0) {
+    nall::print(stderr, "error: unable to listen on ", socket, ": ", strerror(errno), "\n");
+    close(listener);
+    return false;
+  }
+  this->socket = socket;
+  return true;
+  #else
+  nall::print(stderr, "error: -server is not supported on this platform\n");
+  return false;
+  #endif
+}
+
+//the server itself only starts workers, so that it outlives any assembly that crashes one
+bool Server::serve(const Runner& runner) {
+  #if defined(API_POSIX)
+  struct sigaction action = {};
+  action.sa_handler = [](int) { serverStopping = 1; };
+  sigaction(SIGINT, &action, nullptr);
+  sigaction(SIGTERM, &action, nullptr);
+  signal(SIGPIPE, SIG_IGN);
+  nall::print(stderr, "bass: listening on ", socket, "\n");
+
+  bool succeeded = true;
+  while(!serverStopping) {
+    fflush(stdout);
+    fflush(stderr);
+    int pid = fork();
+    if(pid < 0) {
+      nall::print(stderr, "error: unable to start a server worker: ", strerror(errno), "\n");
+      succeeded = false;
+      break;
+    }
+    if(!pid) work(runner);
+
+    int status = 0;
+    while(waitpid(pid, &status, 0) < 0) {
+      if(errno != EINTR) break;
+      if(serverStopping) kill(pid, SIGTERM);
+    }
+    if(serverStopping) break;
+    if(!WIFSIGNALED(status)) {
+      succeeded = false;
+      break;
+    }
+    nall::print(stderr, "bass: server worker stopped by signal ", WTERMSIG(status), "; starting another\n");
+  }
+
+  close(listener);
+  unlink(socket);
+  return succeeded;
+  #else
+  return false;
+  #endif
+}
+
+void Server::work(const Runner& runner) {
+  #if defined(API_POSIX)
+  signal(SIGINT, SIG_DFL);
+  signal(SIGTERM, SIG_DFL);
+  directory = open(".", O_RDONLY);
+  output = dup(STDOUT_FILENO);
+  diagnostics = dup(STDERR_FILENO);
+  if(directory < 0 || output < 0 || diagnostics < 0) _exit(EXIT_FAILURE);
+
+  while(true) {
+    int connection = accept(listener, nullptr, nullptr);
+    if(connection < 0) {
+      if(errno == EINTR || errno == ECONNABORTED) continue;
+      nall::print(stderr, "error: unable to accept a connection: ", strerror(errno), "\n");
+      _exit(EXIT_FAILURE);
+    }
+    answer(connection, runner);
+    close(connection);
+  }
+  #endif
+  _exit(EXIT_FAILURE);
+}
+
+//the assembly runs in the client's working directory, and writes to the client's stdout and stderr
+void Server::answer(int connection, const Runner& runner) {
+  #if defined(API_POSIX)
+  int descriptors[3] = {-1, -1, -1};  //working directory, stdout, stderr
+  Request request = {};
+  iovec io{&request, sizeof(request)};
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(descriptors))];
+  msghdr message = {};
+  message.msg_iov = &io;
+  message.msg_iovlen = 1;
+  message.msg_control = control;
+  message.msg_controllen = sizeof(control);
+  auto received = recvmsg(connection, &message, 0);
+  for(auto header = CMSG_FIRSTHDR(&message); header; header = CMSG_NXTHDR(&message, header)) {
+    if(header->cmsg_level != SOL_SOCKET || header->cmsg_type != SCM_RIGHTS) continue;
+    memcpy(descriptors, CMSG_DATA(header), std::min<size_t>(header->cmsg_len - CMSG_LEN(0), sizeof(descriptors)));
+  }
+  auto release = [&] {
+    for(auto descriptor : descriptors) if(descriptor >= 0) close(descriptor);
+  };
+  if(received != sizeof(request) || request.magic != magic || request.length > maximumLength
+  || descriptors[0] < 0 || descriptors[1] < 0 || descriptors[2] < 0) return release();
+
+  nall::vector<char> payload;
+  payload.resize(request.length);
+  if(!transfer(connection, payload.data(), payload.size(), true)) return release();
+  if(!payload || payload.right()) return release();
+  nall::vector<nall::string> arguments;
+  for(unsigned offset = 0; offset < payload.size();) {
+    nall::string argument = payload.data() + offset;
+    offset += argument.size() + 1;
+    arguments.append(argument);
+  }
+
+  auto wall = std::chrono::steady_clock::now();
+  bool succeeded = false;
+  if(fchdir(descriptors[0]) == 0) {
+    dup2(descriptors[1], STDOUT_FILENO);
+    dup2(descriptors[2], STDERR_FILENO);
+    succeeded = runner(arguments);
+    fflush(stdout);
+    fflush(stderr);
+    dup2(output, STDOUT_FILENO);
+    dup2(diagnostics, STDERR_FILENO);
+    if(fchdir(directory) < 0) _exit(EXIT_FAILURE);
+  }
+  release();
+
+  uint8_t reply = succeeded;
+  transfer(connection, &reply, sizeof(reply), false);
+  char times[32];
+  snprintf(times, sizeof(times), "%10.3f ms", std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - wall).count());
+  nall::print(stderr, "bass: ", succeeded ? "ok    " : "failed", times, "  ", arguments.merge(" "), "\n");
+  #endif
+}
+
+nall::maybe<bool> Server::submit(const nall::string& socket, const nall::vector<nall::string>& arguments) {
+  #if defined(API_POSIX)
+  sockaddr_un address;
+  if(!socketAddress(socket, address)) return nall::nothing;
+  int connection = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if(connection < 0) return nall::nothing;
+  if(connect(connection, (sockaddr*)&address, sizeof(address)) < 0) {
+    close(connection);
+    return nall::nothing;
+  }
+  int directory = open(".", O_RDONLY);
+  if(directory < 0) {
+    close(connection);
+    return nall::nothing;
+  }
+
+  nall::vector<char> payload;
+  for(auto& argument : arguments) {
+    for(char c : argument) payload.append(c);
+    payload.append(0);
+  }
+  signal(SIGPIPE, SIG_IGN);
+  fflush(stdout);
+  fflush(stderr);
+
+  int descriptors[3] = {directory, STDOUT_FILENO, STDERR_FILENO};
+  Request request{magic, (uint32_t)payload.size()};
+  iovec io{&request, sizeof(request)};
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(descriptors))] = {};
+  msghdr message = {};
+  message.msg_iov = &io;
+  message.msg_iovlen = 1;
+  message.msg_control = control;
+  message.msg_controllen = sizeof(control);
+  auto header = CMSG_FIRSTHDR(&message);
+  header->cmsg_level = SOL_SOCKET;
+  header->cmsg_type = SCM_RIGHTS;
+  header->cmsg_len = CMSG_LEN(sizeof(descriptors));
+  memcpy(CMSG_DATA(header), descriptors, sizeof(descriptors));
+  bool sent = sendmsg(connection, &message, 0) == sizeof(request);
+  close(directory);
+  if(!sent) {
+    close(connection);
+    return nall::nothing;
+  }
+
+  //once the request is sent, the server has taken on the assembly; it is not run again here
+  uint8_t reply = 0;
+  bool replied = transfer(connection, payload.data(), payload.size(), false)
+              && transfer(connection, &reply, sizeof(reply), true);
+  close(connection);
+  if(!replied) nall::print(stderr, "error: the server stopped before the assembly finished\n");
+  return replied && reply == 1;
+  #else
+  return nall::nothing;
+  #endif
+}
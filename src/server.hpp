@@ -0,0 +1,39 @@
+#pragma once
+
+#if defined(API_POSIX)
+  #include <sys/socket.h>
+  #include <sys/un.h>
+#endif
+
+//-server: a long-running bass that assembles on behalf of -client, over a local socket.
+//requests are answered one at a time by a worker process that keeps the source files, architecture
+//tables and expression trees of the requests before; should an assembly crash it, another takes its place.
+struct Server {
+  //assembles one request from its command line arguments, reporting diagnostics on stderr
+  using Runner = nall::function<bool (const nall::vector<nall::string>& arguments)>;
+
+  bool listen(const nall::string& socket);
+  bool serve(const Runner& runner);
+
+  //assembles on the server listening on socket; nothing when there is none
+  static nall::maybe<bool> submit(const nall::string& socket, const nall::vector<nall::string>& arguments);
+
+private:
+  //sent by the client along with its working directory, stdout and stderr, and followed by
+  //the arguments, each terminated by a null character. the server replies with one byte, 1 on success.
+  struct Request {
+    uint32_t magic;
+    uint32_t length;  //of the arguments, in bytes
+  };
+  static constexpr uint32_t magic = 0x73736162;  //"bass"
+  static constexpr uint32_t maximumLength = 1 << 20;
+
+  [[noreturn]] void work(const Runner& runner);
+  void answer(int connection, const Runner& runner);
+
+  nall::string socket;
+  int listener = -1;
+  int directory = -1;  //the server's own working directory and output, restored after every request
+  int output = -1;
+  int diagnostics = -1;
+};
@@ -0,0 +1 @@
+db $01, $02  // 01 02
@@ -0,0 +1 @@
+db $03  // 03
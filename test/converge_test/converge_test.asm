@@ -0,0 +1,21 @@
+architecture snes.cpu
+instrument "stb *08 ;$85 =a"
+instrument "stb *16 ;$8d =a"
+instrument "stb *16 ;$8d ~a"
+
+// with -converge, an unsized operand takes the first form its value fits in,
+// and a size hint keeps the form it names
+constant big = $1234
+stb <big    // 85 34
+stb >small  // 8d 12 00
+stb big     // 8d 34 12
+stb small   // 85 12
+stb later   // 85 0d
+
+// a constant defined from a later one settles once a further pass has run
+db first    // 06
+constant first = second + 1
+constant second = 5
+
+later:
+constant small = $12
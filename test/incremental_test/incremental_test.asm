@@ -0,0 +1,12 @@
+architecture snes.cpu
+
+// each output directive starts a region that -incremental keeps for the next assembly
+
+output "a.bin", create
+include "a.inc"
+
+output "b.bin", create
+include "b.inc"
+
+output "c.bin", create
+include "c.inc"
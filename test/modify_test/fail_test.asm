@@ -0,0 +1,6 @@
+architecture none
+origin 5
+db 1, 2, 3
+origin 150000
+db 9
+error "stop"
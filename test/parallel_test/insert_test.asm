@@ -0,0 +1,14 @@
+architecture snes.cpu
+
+// a region that inserts a file an earlier region wrote is written after it
+
+output "header.bin", create
+db "HEAD"
+
+output "rom.bin", create
+db 1, 2, 3, 4
+
+output "copy.bin", create
+insert "header.bin"
+insert block, "rom.bin", 2, 2
+db block, block.size
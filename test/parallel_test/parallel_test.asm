@@ -0,0 +1,34 @@
+architecture snes.cpu
+
+// every output directive starts a region that -jobs may write in its own process;
+// the output must be the same as when the regions are written one after another
+
+output "header.bin", create
+db "HEAD"
+dw main, data.size
+jml main
+
+// regions sharing one target, each writing only its own part of it
+output "rom.bin", create
+base $8000
+main:
+  lda #$12
+  jsr routine
+  bra main
+
+output "rom.bin"
+origin $100
+base $8100
+routine:
+  lda.w data
+  rts
+data:
+  db 1, 2, 3, 4
+data.end:
+constant data.size = data.end - data
+
+output "rom.bin"
+origin $200
+base $8200
+  dw routine, main
+  fill 4, $ff
@@ -0,0 +1,16 @@
+architecture snes.cpu
+
+// a region that reads back a target an earlier region wrote is written after it
+
+output "rom.bin", create
+base $8000
+  lda.w data
+  rts
+data:
+  db 1, 2, 3, 4
+
+output "rom.bin"
+origin $100
+base $8100
+  db read(3), read(4)
+  dw data
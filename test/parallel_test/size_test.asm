@@ -0,0 +1,11 @@
+architecture snes.cpu
+
+// a region that measures a file an earlier region wrote is written after it
+
+output "a.bin", create
+db 1, 2, 3, 4
+
+output "b.bin", create
+db file.size("a.bin"), file.exists("a.bin"), file.exists("missing.bin")
+db later
+constant later = 7
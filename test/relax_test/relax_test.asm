@@ -0,0 +1,16 @@
+architecture nes.cpu
+base $8000
+
+// a branch that reaches keeps its short form; one that does not takes the #relax form of the table
+start:
+  beq start // f0 fe
+  beq far   // d0 03 4c 00 81
+  bne near  // d0 05
+  bcc far   // b0 03 4c 00 81
+near:
+  nop       // ea
+
+  base $8100
+far:
+  bmi near  // 10 03 4c 0e 80
+  bpl far   // 10 f9
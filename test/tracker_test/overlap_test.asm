@@ -0,0 +1,11 @@
+architecture none
+base $8000
+tracker enable
+
+origin 0
+db 1, 2, 3, 4, 5, 6, 7, 8
+origin 12
+db 13, 14
+// the overwrite is reported once, as the span written again: 0x3-0x5 [0x8003-0x8005]
+origin 3
+fill 3
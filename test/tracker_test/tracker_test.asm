@@ -0,0 +1,14 @@
+architecture none
+tracker enable
+
+// writes that only adjoin one another, or follow a reset, are not overwrites
+origin 4
+db 5, 6, 7, 8
+origin 0
+db 1, 2, 3, 4
+origin 8
+dw $dddd, $eeee
+fill 4, $ff
+tracker reset
+origin 2
+dw $aaaa